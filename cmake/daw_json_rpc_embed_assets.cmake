@@ -0,0 +1,34 @@
+# Compiles the files below directory in to target as the
+# daw::json_rpc::embedded_bundle named name, declared in the generated header
+# <name>.h.  The bundle is generated again when a file changes, is added or
+# is removed
+#
+#   daw_json_rpc_embed_assets( my_server web_assets ${CMAKE_SOURCE_DIR}/www )
+#   server.route_path_to( "/", web_assets, "index.html" );
+#
+# Files are stored as they are and, when it makes them smaller, compressed
+# with gzip (CMake 3.19 or later)
+set(DAW_JSON_RPC_EMBED_ASSETS_SCRIPT
+        "${CMAKE_CURRENT_LIST_DIR}/daw_json_rpc_embed_assets_generate.cmake"
+        CACHE INTERNAL "")
+
+function(daw_json_rpc_embed_assets target name directory)
+    get_filename_component(directory "${directory}" ABSOLUTE)
+    set(out_dir "${CMAKE_CURRENT_BINARY_DIR}/daw_json_rpc_assets")
+    file(GLOB_RECURSE assets LIST_DIRECTORIES false CONFIGURE_DEPENDS
+            "${directory}/*")
+    file(GENERATE OUTPUT "${out_dir}/${name}.h" CONTENT
+            "// Generated by daw_json_rpc_embed_assets from ${directory}\n\n#pragma once\n\n#include <daw/json_rpc/json_rpc_embedded.h>\n\nextern daw::json_rpc::embedded_bundle const ${name};\n")
+    add_custom_command(
+            OUTPUT "${out_dir}/${name}.cpp"
+            COMMAND "${CMAKE_COMMAND}"
+            "-DNAME=${name}"
+            "-DDIRECTORY=${directory}"
+            "-DOUTPUT=${out_dir}/${name}.cpp"
+            -P "${DAW_JSON_RPC_EMBED_ASSETS_SCRIPT}"
+            DEPENDS ${assets} "${DAW_JSON_RPC_EMBED_ASSETS_SCRIPT}"
+            COMMENT "Embedding ${directory} as ${name}"
+            VERBATIM)
+    target_sources(${target} PRIVATE "${out_dir}/${name}.cpp")
+    target_include_directories(${target} PRIVATE "${out_dir}")
+endfunction()
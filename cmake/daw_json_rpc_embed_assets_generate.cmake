@@ -0,0 +1,76 @@
+# Writes the C++ source of the embedded_bundle NAME, holding the files below
+# DIRECTORY, to OUTPUT.  Run by daw_json_rpc_embed_assets at build time
+#   cmake -DNAME=<name> -DDIRECTORY=<dir> -DOUTPUT=<file.cpp> -P <this file>
+
+set(bytes_per_line 32)
+set(line_pattern "")
+foreach (n RANGE 1 ${bytes_per_line})
+    string(APPEND line_pattern "\\\\x[0-9a-f][0-9a-f]")
+endforeach ()
+
+# Every byte is a hex escape, so an escape is never followed by a hex digit
+function(to_literal out_var path)
+    file(READ "${path}" hex HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "\\\\x\\1" escaped "${hex}")
+    string(REGEX REPLACE "(${line_pattern})" "\\1\"\n\t  \"" escaped
+            "${escaped}")
+    set(${out_var} "\"${escaped}\"" PARENT_SCOPE)
+endfunction()
+
+function(to_etag out_var path)
+    file(SHA256 "${path}" hash)
+    string(SUBSTRING "${hash}" 0 32 hash)
+    set(${out_var} "\"\\\"${hash}\\\"\"" PARENT_SCOPE)
+endfunction()
+
+file(GLOB_RECURSE files LIST_DIRECTORIES false RELATIVE "${DIRECTORY}"
+        "${DIRECTORY}/*")
+list(SORT files)
+
+set(data "")
+set(table "")
+set(index 0)
+set(gzip_file "${OUTPUT}.gz")
+foreach (rel IN LISTS files)
+    set(path "${DIRECTORY}/${rel}")
+    to_literal(contents "${path}")
+    to_etag(etag "${path}")
+    set(gzip "\"\"")
+    set(gzip_etag "\"\"")
+    if (CMAKE_VERSION VERSION_GREATER_EQUAL 3.19)
+        file(ARCHIVE_CREATE OUTPUT "${gzip_file}" PATHS "${path}"
+                FORMAT raw COMPRESSION GZip COMPRESSION_LEVEL 9)
+        file(SIZE "${path}" size)
+        file(SIZE "${gzip_file}" gzip_size)
+        if (gzip_size LESS size)
+            to_literal(gzip "${gzip_file}")
+            to_etag(gzip_etag "${gzip_file}")
+        endif ()
+        file(REMOVE "${gzip_file}")
+    endif ()
+    string(APPEND data
+            "\tconstexpr char contents_${index}[] =\n\t  ${contents};\n"
+            "\tconstexpr char gzip_${index}[] =\n\t  ${gzip};\n\n")
+    string(REPLACE "\\" "\\\\" rel "${rel}")
+    string(REPLACE "\"" "\\\"" rel "${rel}")
+    string(APPEND table
+            "\t  { \"${rel}\",\n"
+            "\t    { contents_${index}, sizeof( contents_${index} ) - 1 },\n"
+            "\t    ${etag},\n"
+            "\t    { gzip_${index}, sizeof( gzip_${index} ) - 1 },\n"
+            "\t    ${gzip_etag} },\n")
+    math(EXPR index "${index} + 1")
+endforeach ()
+
+set(source "// Generated by daw_json_rpc_embed_assets from ${DIRECTORY}\n\n")
+string(APPEND source "#include <daw/json_rpc/json_rpc_embedded.h>\n\n")
+if (index EQUAL 0)
+    string(APPEND source "extern daw::json_rpc::embedded_bundle const ${NAME}{ };\n")
+else ()
+    string(APPEND source
+            "namespace {\n${data}"
+            "\tconstexpr daw::json_rpc::embedded_file files[] = {\n${table}\t};\n"
+            "} // namespace\n\n"
+            "extern daw::json_rpc::embedded_bundle const ${NAME}{ files };\n")
+endif ()
+file(WRITE "${OUTPUT}" "${source}")
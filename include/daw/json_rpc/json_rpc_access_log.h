@@ -0,0 +1,135 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace daw::json_rpc {
+	struct access_log_options {
+		/// File the log is written to.  Rotated files get the suffixes .1, .2 ...
+		/// with .1 the newest
+		std::filesystem::path path{ };
+		/// Size at which the file is rotated
+		std::uint64_t max_file_size = 64U * 1024U * 1024U;
+		/// Rotated files kept.  0 truncates the file instead of rotating it
+		std::size_t max_files = 4;
+		/// Records buffered per thread, rounded up to a power of two.  Records
+		/// logged while a thread's buffer is full are dropped
+		std::size_t buffer_size = 1024;
+		/// How often buffered records are written to the file
+		std::chrono::milliseconds flush_interval = std::chrono::milliseconds( 100 );
+	};
+
+	/// @brief A fixed size log record.  Longer methods and ids are truncated
+	struct access_record {
+		static constexpr std::size_t max_method_size = 47;
+		static constexpr std::size_t max_id_size = 31;
+
+		std::chrono::system_clock::time_point time{ };
+		std::chrono::nanoseconds latency{ };
+		/// Size of the response
+		std::uint64_t bytes = 0;
+		/// The JSON-RPC error code, 0 for a result
+		std::int32_t status = 0;
+		std::uint8_t method_size = 0;
+		std::uint8_t id_size = 0;
+		std::array<char, max_method_size> method{ };
+		/// The JSON text of the id, empty for a notification
+		std::array<char, max_id_size> id{ };
+
+		void set_method( std::string_view m );
+		void set_id( std::string_view i );
+	};
+
+	struct access_log_stats {
+		std::uint64_t written = 0;
+		std::uint64_t dropped = 0;
+		/// Records lost because the file could not be opened or written
+		std::uint64_t failed = 0;
+	};
+
+	/// @brief An access log written by a background thread.  Each thread
+	/// logging records has its own lock-free ring buffer, so logging never
+	/// blocks or contends with other threads.  Destroying the log writes the
+	/// records still buffered
+	class access_log {
+		struct ring;
+
+		access_log_options m_options;
+		std::uint64_t const m_id;
+		mutable std::mutex m_rings_mutex{ };
+		// Threads keep weak references to their rings, to release them on exit
+		std::vector<std::shared_ptr<ring>> m_rings{ };
+		std::FILE *m_file = nullptr;
+		std::uint64_t m_file_size = 0;
+		std::atomic<std::uint64_t> m_written = 0;
+		std::atomic<std::uint64_t> m_failed = 0;
+		std::mutex m_sleep_mutex{ };
+		std::condition_variable m_cv{ };
+		bool m_stopping = false;
+		std::thread m_thread{ };
+
+		ring &local_ring( );
+		void drain( );
+		bool drain_once( std::vector<char> &out );
+		bool write( std::vector<char> const &out );
+		void rotate( );
+
+	public:
+		/// @throws std::system_error when the file cannot be opened
+		explicit access_log( access_log_options opts );
+		~access_log( );
+
+		access_log( access_log && ) = delete;
+		access_log &operator=( access_log && ) = delete;
+		access_log( access_log const & ) = delete;
+		access_log &operator=( access_log const & ) = delete;
+
+		/// @brief Buffer a record to be written.  Never blocks
+		/// @return false if the record was dropped because the calling thread's
+		/// buffer is full
+		bool log( access_record const &record );
+
+		[[nodiscard]] access_log_stats stats( ) const;
+	};
+
+	namespace details {
+		inline thread_local access_log *current_access_log = nullptr;
+
+		/// @brief Makes log the calling thread's access log for its lifetime.
+		/// Requests dispatched in the scope are logged to it
+		class access_log_scope {
+			access_log *m_previous;
+
+		public:
+			explicit access_log_scope( access_log *log )
+			  : m_previous( std::exchange( current_access_log, log ) ) {}
+
+			~access_log_scope( ) {
+				current_access_log = m_previous;
+			}
+
+			access_log_scope( access_log_scope const & ) = delete;
+			access_log_scope &operator=( access_log_scope const & ) = delete;
+		};
+	} // namespace details
+} // namespace daw::json_rpc
@@ -0,0 +1,92 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace daw::json_rpc {
+	/// @brief Limits on the number of requests being processed at once.
+	/// Requests beyond the limit are rejected immediately rather than queued
+	struct admission_options {
+		static constexpr std::size_t unlimited =
+		  std::numeric_limits<std::size_t>::max( );
+		/// Where an adaptive limit without a max_in_flight starts
+		static constexpr std::size_t initial_adaptive_limit = 100;
+
+		/// Maximum number of requests in flight
+		std::size_t max_in_flight = unlimited;
+		/// When non-zero the limit adapts to the measured latency.  It shrinks
+		/// while requests take longer than target_latency and grows back towards
+		/// max_in_flight while they do not.  Without a max_in_flight it starts at
+		/// initial_adaptive_limit, or min_in_flight when that is larger
+		std::chrono::microseconds target_latency{ 0 };
+		/// The adaptive limit never shrinks below this
+		std::size_t min_in_flight = 1;
+	};
+
+	namespace details {
+		/// @brief Whether the options limit anything, so a limiter is needed
+		[[nodiscard]] constexpr bool
+		is_admission_limited( admission_options const &opts ) {
+			return opts.max_in_flight != admission_options::unlimited or
+			       opts.target_latency.count( ) > 0;
+		}
+
+		class concurrency_limiter {
+			std::atomic<std::size_t> m_in_flight = 0;
+			std::atomic<std::size_t> m_limit;
+			std::atomic<std::size_t> m_max;
+			std::atomic<std::size_t> m_min;
+			std::atomic<std::int64_t> m_target_us;
+
+		public:
+			explicit concurrency_limiter( admission_options const &opts = { } );
+
+			/// @brief Change the limits, e.g. before the server starts
+			void configure( admission_options const &opts );
+
+			/// @brief Take a slot if the limit has not been reached.  Every
+			/// successful call must be matched by a call to release
+			[[nodiscard]] bool try_acquire( );
+
+			/// @brief Give back a slot, reporting how long the request took
+			void release( std::chrono::steady_clock::duration latency );
+
+			[[nodiscard]] std::size_t limit( ) const;
+			[[nodiscard]] std::size_t in_flight( ) const;
+		};
+
+		/// @brief A slot taken from a concurrency_limiter that is released, with
+		/// the time since it was taken, when destroyed
+		class admission_ticket {
+			concurrency_limiter *m_limiter = nullptr;
+			std::chrono::steady_clock::time_point m_start{ };
+
+		public:
+			admission_ticket( ) = default;
+
+			/// @brief Try to take a slot from limiter, check with operator bool
+			explicit admission_ticket( concurrency_limiter &limiter );
+
+			admission_ticket( admission_ticket &&other ) noexcept;
+			admission_ticket &operator=( admission_ticket &&other ) noexcept;
+			admission_ticket( admission_ticket const & ) = delete;
+			admission_ticket &operator=( admission_ticket const & ) = delete;
+			~admission_ticket( );
+
+			explicit operator bool( ) const {
+				return m_limiter != nullptr;
+			}
+		};
+	} // namespace details
+} // namespace daw::json_rpc
@@ -0,0 +1,140 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include "json_rpc_task.h"
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+namespace daw::json_rpc {
+	/// @brief The serialized response of a request that completes after its
+	/// handler has returned.  A default constructed deferred_response is empty
+	/// and means the response was written synchronously
+	class deferred_response {
+		struct state_t {
+			std::mutex mutex{ };
+			std::optional<std::string> value{ };
+			std::function<void( std::string )> on_ready{ };
+		};
+		std::shared_ptr<state_t> m_state{ };
+
+		explicit deferred_response( std::shared_ptr<state_t> state );
+
+	public:
+		deferred_response( ) = default;
+
+		/// @brief Create a response that is pending until set_value is called
+		[[nodiscard]] static deferred_response make( );
+
+		/// @brief Is the response still to be delivered through on_ready
+		[[nodiscard]] bool is_pending( ) const;
+
+		explicit operator bool( ) const {
+			return is_pending( );
+		}
+
+		/// @brief Complete the response.  Must be called once
+		void set_value( std::string response ) const;
+
+		/// @brief Register the function that receives the response.  It is
+		/// called immediately when the response is already complete
+		void on_ready( std::function<void( std::string )> f ) const;
+	};
+
+	namespace details {
+		/// @brief Hand a poll function to the shared future waiter thread.  poll
+		/// is called until it returns true, which it does once it has delivered
+		/// its result
+		void when_ready( std::function<bool( )> poll );
+
+		template<typename T>
+		concept Awaitable = requires( T &t ) {
+			t.await_ready( );
+			t.await_resume( );
+		};
+
+		template<typename T>
+		struct async_result_traits {
+			static constexpr bool is_async = false;
+			using value_type = T;
+		};
+
+		template<typename T>
+		struct async_result_traits<std::future<T>> {
+			static constexpr bool is_async = true;
+			using value_type = T;
+		};
+
+		template<typename T>
+		struct async_result_traits<task<T>> {
+			static constexpr bool is_async = true;
+			using value_type = T;
+		};
+
+		template<typename T>
+		requires( Awaitable<T> and not is_task_v<T> ) //
+		  struct async_result_traits<T> {
+			static constexpr bool is_async = true;
+			using value_type =
+			  std::remove_cvref_t<decltype( std::declval<T &>( ).await_resume( ) )>;
+		};
+
+		template<typename T>
+		inline constexpr bool is_async_result_v =
+		  async_result_traits<std::remove_cvref_t<T>>::is_async;
+
+		template<typename T>
+		using async_value_t =
+		  typename async_result_traits<std::remove_cvref_t<T>>::value_type;
+
+		template<Awaitable A>
+		task<async_value_t<A>> as_task( A aw ) {
+			co_return co_await std::move( aw );
+		}
+
+		/// @brief Call on_done with a function returning the result, or
+		/// rethrowing the exception, of the asynchronous operation once it has
+		/// completed
+		template<typename AsyncResult, typename OnDone>
+		void when_done( AsyncResult &&r, OnDone on_done ) {
+			using result_t = std::remove_cvref_t<AsyncResult>;
+			if constexpr( is_task_v<result_t> ) {
+				result_t::start( std::move( r ),
+				                 [on_done = std::move( on_done )]( auto &promise ) {
+					                 on_done( [&]( ) -> decltype( auto ) {
+						                 return std::move( promise ).get( );
+					                 } );
+				                 } );
+			} else if constexpr( Awaitable<result_t> ) {
+				when_done( as_task( std::move( r ) ), std::move( on_done ) );
+			} else {
+				// std::future has no continuation support, so the waiter thread polls
+				// it.  Prefer returning a task for large numbers of slow calls
+				auto fut = std::make_shared<result_t>( std::move( r ) );
+				when_ready( [fut, on_done = std::move( on_done )]( ) mutable {
+					if( fut->wait_for( std::chrono::seconds( 0 ) ) !=
+					    std::future_status::ready ) {
+						return false;
+					}
+					on_done( [&]( ) -> decltype( auto ) {
+						return fut->get( );
+					} );
+					return true;
+				} );
+			}
+		}
+	} // namespace details
+} // namespace daw::json_rpc
@@ -0,0 +1,42 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include "json_rpc_async.h"
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <utility>
+
+namespace daw::json_rpc::details {
+	/// @brief Take an empty buffer from the calling thread's pool, with at
+	/// least size_hint bytes of capacity.  Buffers keep the capacity they grew
+	/// to, so after warming up they rarely need to allocate
+	[[nodiscard]] std::string acquire_buffer( std::size_t size_hint = 0 );
+
+	/// @brief Return a buffer to the calling thread's pool.  Very large buffers
+	/// and buffers beyond the pool's limit are freed instead
+	void release_buffer( std::string &&buff );
+
+	/// @brief Call f( buff ) with buff reserved to the size of the previous
+	/// response recorded in size_hint, then record the size of this one.
+	/// Responses that complete asynchronously are not recorded
+	template<typename F>
+	deferred_response write_sized( std::atomic<std::size_t> &size_hint,
+	                               std::string &buff, F &&f ) {
+		auto const start = buff.size( );
+		buff.reserve( start + size_hint.load( std::memory_order_relaxed ) );
+		auto resp = f( buff );
+		if( not resp ) {
+			size_hint.store( buff.size( ) - start, std::memory_order_relaxed );
+		}
+		return resp;
+	}
+} // namespace daw::json_rpc::details
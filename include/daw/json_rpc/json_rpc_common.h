@@ -19,6 +19,9 @@ namespace daw::json_rpc::details {
 	using id_type = std::optional<req_id_type>;
 	static constexpr inline char const id_json_mem_name[] = "id";
 
+	/// The id of a request as it appears in the request document
+	using raw_id_type = std::optional<daw::json::json_value>;
+
 	using id_json_map_type = daw::json::json_variant_null<
 	  id_json_mem_name, id_type,
 	  daw::json::json_variant_type_list<double, std::string>,
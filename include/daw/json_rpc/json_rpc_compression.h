@@ -0,0 +1,43 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace daw::json_rpc {
+	struct compression_options {
+		/// Responses smaller than this are sent as they are, as compressing
+		/// them costs more time than sending the bytes saved
+		std::size_t min_size = 1024;
+		/// zlib compression level, from 1, the fastest, to 9, the smallest
+		int level = 6;
+	};
+
+	namespace details {
+		enum class content_coding { identity, gzip, deflate };
+
+		/// @brief The coding to send a response in for an Accept-Encoding header
+		/// value.  gzip is preferred to deflate, which some clients mistake for
+		/// raw deflate data
+		[[nodiscard]] content_coding
+		select_coding( std::string_view accept_encoding );
+
+		/// @brief The name of coding in Content-Encoding
+		[[nodiscard]] char const *coding_name( content_coding coding );
+
+		/// @brief Replaces the contents of out with in compressed by coding.
+		/// The compressor of the calling thread is reset and reused, so only
+		/// the first call on a thread allocates its state
+		/// @return false when in could not be compressed
+		[[nodiscard]] bool compress( content_coding coding, int level,
+		                             std::string_view in, std::string &out );
+	} // namespace details
+} // namespace daw::json_rpc
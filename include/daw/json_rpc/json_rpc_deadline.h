@@ -0,0 +1,94 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace daw::json_rpc {
+	using deadline_clock = std::chrono::steady_clock;
+	using deadline_type = std::optional<deadline_clock::time_point>;
+
+	/// HTTP header holding the number of milliseconds the caller will wait for
+	/// the response.  A request can also carry a "timeout_ms" member for the same
+	/// purpose, which is how members of a batch and WebSocket requests set theirs
+	inline constexpr char const request_timeout_header[] = "X-Request-Timeout-Ms";
+
+	/// Longer timeouts are shortened to this, keeping the deadline within the
+	/// range of deadline_clock
+	inline constexpr auto max_request_timeout = std::chrono::hours( 24 );
+
+	/// The deadline of the request being handled by the calling thread.
+	/// Asynchronous handlers that need it after their first suspension should
+	/// copy it before then
+	namespace this_request {
+		/// @brief The deadline, if the caller set one
+		[[nodiscard]] deadline_type deadline( );
+
+		/// @brief Time left before the deadline, max( ) when there is none
+		[[nodiscard]] deadline_clock::duration remaining( );
+
+		/// @brief Has the deadline passed.  Long running handlers can poll this to
+		/// stop early
+		[[nodiscard]] bool is_expired( );
+	} // namespace this_request
+
+	namespace details {
+		[[nodiscard]] inline bool is_expired( deadline_type const &deadline ) {
+			return deadline and *deadline <= deadline_clock::now( );
+		}
+
+		/// @brief The deadline timeout_ms after start.  A timeout sent by a
+		/// client is not trusted: a negative one is ignored and a long one is
+		/// shortened to max_request_timeout
+		[[nodiscard]] inline deadline_type
+		deadline_after( deadline_clock::time_point start,
+		                std::int64_t timeout_ms ) {
+			if( timeout_ms < 0 ) {
+				return { };
+			}
+			constexpr auto max_ms =
+			  std::chrono::milliseconds( max_request_timeout ).count( );
+			return start + std::chrono::milliseconds(
+			                 timeout_ms < max_ms ? timeout_ms : max_ms );
+		}
+
+		/// @brief The earlier of a deadline and one timeout_ms after received
+		[[nodiscard]] inline deadline_type
+		earliest_deadline( deadline_type deadline,
+		                   deadline_clock::time_point received,
+		                   std::optional<std::int64_t> timeout_ms ) {
+			if( not timeout_ms ) {
+				return deadline;
+			}
+			auto const d = deadline_after( received, *timeout_ms );
+			if( not d ) {
+				return deadline;
+			}
+			if( not deadline or *d < *deadline ) {
+				return d;
+			}
+			return deadline;
+		}
+
+		/// @brief Makes deadline the calling thread's request deadline for its
+		/// lifetime
+		class deadline_scope {
+			deadline_type m_previous;
+
+		public:
+			explicit deadline_scope( deadline_type deadline );
+			~deadline_scope( );
+
+			deadline_scope( deadline_scope const & ) = delete;
+			deadline_scope &operator=( deadline_scope const & ) = delete;
+		};
+	} // namespace details
+} // namespace daw::json_rpc
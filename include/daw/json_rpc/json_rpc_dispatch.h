@@ -7,12 +7,21 @@
 #pragma once
 
 #include "daw/daw_function_traits.h"
+#include "daw/json_rpc/json_rpc_admission.h"
+#include "daw/json_rpc/json_rpc_deadline.h"
+#include "daw/json_rpc/json_rpc_generator.h"
+#include "daw/json_rpc/json_rpc_metrics.h"
 #include "daw/json_rpc/json_rpc_request_handler.h"
+#include "daw/json_rpc/json_rpc_result_cache.h"
 #include "daw/json_rpc/json_rpc_server_request.h"
+#include "daw/json_rpc/json_rpc_thread_pool.h"
 
 #include <daw/json/daw_json_link.h>
 #include <daw/daw_move.h>
+#include <daw/daw_string_view.h>
 
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <type_traits>
@@ -27,15 +36,92 @@ namespace daw::json_rpc {
 		struct make_handler<Result, daw::fwd_pack<Args...>> {
 			using handler = json_rpc::request_handler<Result( Args... )>;
 		};
+
+		template<typename Sig>
+		struct signature_result;
+
+		template<typename Result, typename... Args>
+		struct signature_result<Result( Args... )> {
+			using type = Result;
+		};
 	} // namespace impl
 
+	struct batch_options {
+		/// Pool used to run the members of a batch request in parallel.  When
+		/// empty the members are run in order on the calling thread
+		std::shared_ptr<thread_pool> pool{ };
+		/// Maximum number of threads, including the calling thread, that will
+		/// work on a single batch
+		std::size_t max_fan_out = 1;
+	};
+
+	/// @brief Per method registration options
+	struct method_options {
+		/// Name of a pool, added with json_rpc_dispatch::add_pool, that the
+		/// handler runs on.  When empty the handler runs inline on the thread that
+		/// received the request
+		std::string pool{ };
+		/// Lane the method's calls are queued in on its pool.  Use
+		/// priority::high for health checks and control methods that must keep
+		/// running while bulk methods saturate the pool
+		priority lane = priority::normal;
+		/// Serve repeated calls with the same params from a cache of results
+		cache_options cache{ };
+		/// While a call is running, calls with the same params wait for its
+		/// result instead of running the handler themselves
+		bool single_flight = false;
+		/// Concurrency limit for the method.  Calls beyond it are rejected with a
+		/// -32000 "Server busy" error
+		admission_options admission{ };
+	};
+
+	struct process_result {
+		/// False when the document was not valid JSON
+		bool is_valid = true;
+		/// When pending, the response is delivered through it once the
+		/// asynchronous handlers complete and the response buffer is unused
+		deferred_response deferred{ };
+	};
+
+	namespace details {
+		/// @brief A non-owning reference to anything that dispatches a single
+		/// request, e.g. json_rpc_dispatch or static_dispatch
+		class dispatcher_ref {
+			void const *m_obj;
+			deferred_response ( *m_fn )( void const *, json_rpc_server_request const &,
+			                             std::string & );
+
+		public:
+			template<typename Dispatcher>
+			dispatcher_ref( Dispatcher const &d )
+			  : m_obj( &d )
+			  , m_fn( []( void const *obj, json_rpc_server_request const &req,
+			              std::string &buff ) -> deferred_response {
+				  return ( *static_cast<Dispatcher const *>( obj ) )( req, buff );
+			  } ) {}
+
+			deferred_response operator( )( json_rpc_server_request const &req,
+			                               std::string &buff ) const {
+				return m_fn( m_obj, req, buff );
+			}
+		};
+
+		/// @brief Parse a single request or batch from json_doc and dispatch it.
+		/// See json_rpc_dispatch::process
+		[[nodiscard]] process_result
+		process_document( dispatcher_ref dispatcher, batch_options const &batch,
+		                  daw::string_view json_doc, std::string &buff,
+		                  deadline_type deadline = { } );
+	} // namespace details
+
 	struct json_rpc_dispatch {
-		using storage_t = std::aligned_storage_t<64, 64>;
+		using storage_t = std::aligned_storage_t<256, 64>;
 
 	private:
 		storage_t m_storage{ };
 
-		void add_method( std::string, json_rpc::callback_type && );
+		void add_method( std::string, json_rpc::callback_type &&, method_options &&,
+		                 bool is_streamed );
 
 	public:
 		struct deduce_signature;
@@ -48,29 +134,83 @@ namespace daw::json_rpc {
 		operator=( json_rpc_dispatch const &rhs ) noexcept( false );
 		~json_rpc_dispatch( );
 
-		void operator( )( details::json_rpc_server_request const &req,
-		                  std::string &buff ) const;
+		deferred_response operator( )( details::json_rpc_server_request const &req,
+		                               std::string &buff ) const;
+
+		/// @brief Process a JSON-RPC document holding either a single request or
+		/// a batch of requests.  The response is appended to buff, which is left
+		/// empty when there is nothing to send back(e.g. only notifications).
+		/// Requests served by asynchronous handlers complete through the returned
+		/// deferred response instead.  Requests still waiting to run when
+		/// deadline passes are answered with a -32002 "Deadline exceeded" error
+		[[nodiscard]] process_result process( daw::string_view json_doc,
+		                                      std::string &buff,
+		                                      deadline_type deadline = { } ) const;
+
+		/// @brief Set how the members of batch requests are executed.  Unlike
+		/// the method table, this must not change while requests are processed
+		json_rpc_dispatch &set_batch_options( batch_options opts ) &;
+
+		/// @brief The cache hits and misses of a method added with caching
+		/// enabled.  Zero for any other method
+		[[nodiscard]] cache_stats get_cache_stats( std::string_view method ) const;
+
+		/// @brief Set how the calls of methods are measured.  Applies to methods
+		/// added afterwards
+		json_rpc_dispatch &set_metrics_options( metrics_options opts ) &;
 
+		/// @brief Append the call counts, error counts and latency histograms of
+		/// the methods in the Prometheus text format
+		void write_metrics( std::string &out ) const;
+
+		/// @brief Add a named pool that methods can be run on, isolating heavy
+		/// methods from the threads receiving requests.  Requests for a method
+		/// whose pool already has max_queued requests waiting are rejected with a
+		/// -32000 "Server busy" error
+		json_rpc_dispatch &
+		add_pool( std::string name, std::size_t thread_count,
+		          std::size_t max_queued = thread_pool::unbounded ) &;
+
+		/// @brief A pool added with add_pool, e.g. to read its lane statistics.
+		/// Empty if there is no pool with that name
+		[[nodiscard]] std::shared_ptr<thread_pool>
+		get_pool( std::string_view name ) const;
+
+		/// @brief Remove a method.  Requests already running it are unaffected.
+		/// Like add_method, this is safe while requests are being processed
+		json_rpc_dispatch &remove_method( std::string_view name ) &;
+
+		/// @brief Add or replace a method.  The method table is replaced as a
+		/// whole, so methods can be added while the server is running.  Requests
+		/// in flight finish with the table they started with.  Throws
+		/// std::invalid_argument for a method returning a generator with caching
+		/// enabled, as its result may be sent in parts
 		template<typename Sig = deduce_signature, typename Handler,
 		         typename std::enable_if_t<
 		           not is_request_handler_v<daw::remove_cvref_t<Handler>>,
 		           std::nullptr_t> = nullptr>
-		inline json_rpc_dispatch &add_method( std::string name,
-		                                      Handler &&handler ) & {
+		inline json_rpc_dispatch &add_method( std::string name, Handler &&handler,
+		                                      method_options opts = { } ) & {
 
 			using handler_t = daw::remove_cvref_t<Handler>;
 			if constexpr( is_request_handler_v<handler_t> ) {
-				add_method( std::move( name ), DAW_FWD( handler ).callback( ) );
+				add_method( std::move( name ), DAW_FWD( handler ).callback( ),
+				            std::move( opts ), false );
 			} else if constexpr( std::is_same_v<Sig, deduce_signature> ) {
 				using func_t = daw::func::function_traits<handler_t>;
 				using make_handler_t = impl::make_handler<typename func_t::result_t,
 				                                          typename func_t::params_t>;
 				using req_handler_t = typename make_handler_t::handler;
-				add_method( std::move( name ),
-				            req_handler_t( DAW_FWD( handler ) ).callback( ) );
+				add_method(
+				  std::move( name ), req_handler_t( DAW_FWD( handler ) ).callback( ),
+				  std::move( opts ),
+				  is_generator_v<daw::remove_cvref_t<typename func_t::result_t>> );
 			} else /* explicitly specified signature */ {
+				using result_t = typename impl::signature_result<Sig>::type;
 				add_method( std::move( name ),
-				            request_handler<Sig>( DAW_FWD( handler ) ).callback( ) );
+				            request_handler<Sig>( DAW_FWD( handler ) ).callback( ),
+				            std::move( opts ),
+				            is_generator_v<daw::remove_cvref_t<result_t>> );
 			}
 			return *this;
 		}
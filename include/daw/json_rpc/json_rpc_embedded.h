@@ -0,0 +1,49 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <algorithm>
+#include <span>
+#include <string_view>
+
+namespace daw::json_rpc {
+	/// @brief A file compiled in to the binary
+	struct embedded_file {
+		/// Path relative to the embedded directory, with / separators
+		std::string_view path{ };
+		std::string_view contents{ };
+		/// Strong validator derived from the contents
+		std::string_view etag{ };
+		/// The contents compressed with gzip, empty when that is not smaller
+		std::string_view gzip{ };
+		std::string_view gzip_etag{ };
+	};
+
+	/// @brief The files below a directory, compiled in to the binary by the
+	/// daw_json_rpc_embed_assets CMake function.  The generated header
+	/// <name>.h declares the bundle as a global named name
+	struct embedded_bundle {
+		/// Sorted by path
+		std::span<embedded_file const> files{ };
+
+		/// @brief The file at path, null when there is none
+		[[nodiscard]] constexpr embedded_file const *
+		find( std::string_view path ) const {
+			auto const pos = std::lower_bound(
+			  files.begin( ), files.end( ), path,
+			  []( embedded_file const &file, std::string_view p ) {
+				  return file.path < p;
+			  } );
+			if( pos == files.end( ) or pos->path != path ) {
+				return nullptr;
+			}
+			return &*pos;
+		}
+	};
+} // namespace daw::json_rpc
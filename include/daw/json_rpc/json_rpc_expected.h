@@ -0,0 +1,102 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <daw/daw_move.h>
+
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <version>
+
+#if defined( __cpp_lib_expected )
+#include <expected>
+#endif
+
+namespace daw::json_rpc {
+	template<typename E>
+	class unexpected {
+		E m_error;
+
+	public:
+		explicit unexpected( E err )
+		  : m_error( std::move( err ) ) {}
+
+		[[nodiscard]] E const &error( ) const & {
+			return m_error;
+		}
+
+		[[nodiscard]] E &&error( ) && {
+			return std::move( m_error );
+		}
+	};
+
+	template<typename E>
+	unexpected( E ) -> unexpected<E>;
+
+	/// @brief Holds either the result of a handler or the Error<Data> to
+	/// respond with.  Handlers returning an expected report errors without
+	/// throwing, and the error is written as a json_rpc_response_error with its
+	/// code, message and data
+	template<typename T, typename E>
+	class expected {
+		std::variant<T, E> m_value;
+
+	public:
+		using value_type = T;
+		using error_type = E;
+
+		template<typename U = T,
+		         std::enable_if_t<std::is_convertible_v<U, T>, std::nullptr_t> =
+		           nullptr>
+		expected( U &&value )
+		  : m_value( std::in_place_index<0>, DAW_FWD( value ) ) {}
+
+		template<typename G>
+		expected( unexpected<G> err )
+		  : m_value( std::in_place_index<1>, std::move( err ).error( ) ) {}
+
+		[[nodiscard]] bool has_value( ) const {
+			return m_value.index( ) == 0;
+		}
+
+		explicit operator bool( ) const {
+			return has_value( );
+		}
+
+		[[nodiscard]] T const &value( ) const & {
+			return std::get<0>( m_value );
+		}
+
+		[[nodiscard]] T &value( ) & {
+			return std::get<0>( m_value );
+		}
+
+		[[nodiscard]] T const &operator*( ) const & {
+			return *std::get_if<0>( &m_value );
+		}
+
+		[[nodiscard]] E const &error( ) const & {
+			return *std::get_if<1>( &m_value );
+		}
+	};
+
+	namespace details {
+		template<typename>
+		inline constexpr bool is_expected_v = false;
+
+		template<typename T, typename E>
+		inline constexpr bool is_expected_v<expected<T, E>> = true;
+
+#if defined( __cpp_lib_expected )
+		template<typename T, typename E>
+		inline constexpr bool is_expected_v<std::expected<T, E>> = true;
+#endif
+	} // namespace details
+} // namespace daw::json_rpc
@@ -0,0 +1,143 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace daw::json_rpc {
+	/// @brief A coroutine producing a sequence of T with co_yield.  Handlers
+	/// returning a generator have their result serialized as an array while the
+	/// values are produced, so the whole result is never held in memory.
+	/// Streamed methods cannot be added with caching, as it would only see the
+	/// last part of a response sent in parts
+	template<typename T>
+	class [[nodiscard]] generator {
+	public:
+		using value_type = std::remove_cvref_t<T>;
+
+		struct promise_type {
+			value_type const *current = nullptr;
+			std::exception_ptr exception{ };
+
+			generator get_return_object( ) {
+				return generator(
+				  std::coroutine_handle<promise_type>::from_promise( *this ) );
+			}
+
+			std::suspend_always initial_suspend( ) noexcept {
+				return { };
+			}
+
+			std::suspend_always final_suspend( ) noexcept {
+				return { };
+			}
+
+			// The yielded value, temporary or not, lives until the generator is
+			// resumed
+			std::suspend_always yield_value( value_type const &value ) noexcept {
+				current = std::addressof( value );
+				return { };
+			}
+
+			void return_void( ) {}
+
+			void unhandled_exception( ) {
+				exception = std::current_exception( );
+			}
+		};
+
+		class iterator {
+			std::coroutine_handle<promise_type> m_handle{ };
+
+		public:
+			using value_type = generator::value_type;
+			using difference_type = std::ptrdiff_t;
+
+			iterator( ) = default;
+			explicit iterator( std::coroutine_handle<promise_type> h )
+			  : m_handle( h ) {}
+
+			value_type const &operator*( ) const {
+				return *m_handle.promise( ).current;
+			}
+
+			iterator &operator++( ) {
+				resume( m_handle );
+				return *this;
+			}
+
+			void operator++( int ) {
+				++*this;
+			}
+
+			friend bool operator==( iterator const &it, std::default_sentinel_t ) {
+				return it.m_handle.done( );
+			}
+		};
+
+	private:
+		std::coroutine_handle<promise_type> m_handle{ };
+
+		explicit generator( std::coroutine_handle<promise_type> h )
+		  : m_handle( h ) {}
+
+		static void resume( std::coroutine_handle<promise_type> h ) {
+			h.resume( );
+			if( auto ex = std::exchange( h.promise( ).exception, nullptr ); ex ) {
+				std::rethrow_exception( ex );
+			}
+		}
+
+	public:
+		generator( generator &&other ) noexcept
+		  : m_handle( std::exchange( other.m_handle, nullptr ) ) {}
+
+		generator &operator=( generator &&rhs ) noexcept {
+			if( this != &rhs ) {
+				if( m_handle ) {
+					m_handle.destroy( );
+				}
+				m_handle = std::exchange( rhs.m_handle, nullptr );
+			}
+			return *this;
+		}
+
+		generator( generator const & ) = delete;
+		generator &operator=( generator const & ) = delete;
+
+		~generator( ) {
+			if( m_handle ) {
+				m_handle.destroy( );
+			}
+		}
+
+		/// @brief Runs the coroutine to its first value.  Can only be called
+		/// once
+		iterator begin( ) {
+			resume( m_handle );
+			return iterator( m_handle );
+		}
+
+		std::default_sentinel_t end( ) const noexcept {
+			return { };
+		}
+	};
+
+	template<typename>
+	inline constexpr bool is_generator_v = false;
+
+	template<typename T>
+	inline constexpr bool is_generator_v<generator<T>> = true;
+} // namespace daw::json_rpc
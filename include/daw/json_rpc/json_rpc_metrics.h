@@ -0,0 +1,117 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace daw::json_rpc {
+	struct metrics_options {
+		/// Record calls, errors and latencies of the dispatcher's methods
+		bool enabled = true;
+		/// Time one call in this many on each thread.  Calls and errors are
+		/// always counted, reading the clock is what costs
+		std::uint32_t sample_every = 8;
+	};
+
+	namespace details {
+		using metrics_clock = std::chrono::steady_clock;
+
+		/// Time points of the call being timed on this thread, set by
+		/// invoke_handler as the call moves from decoding params to running the
+		/// handler to serializing its result
+		struct call_timing {
+			metrics_clock::time_point decoded{ };
+			metrics_clock::time_point handled{ };
+		};
+
+		inline thread_local call_timing *current_call_timing = nullptr;
+
+		inline void mark_params_decoded( ) {
+			if( auto *t = current_call_timing; t ) {
+				t->decoded = metrics_clock::now( );
+			}
+		}
+
+		inline void mark_handler_returned( ) {
+			if( auto *t = current_call_timing; t ) {
+				t->handled = metrics_clock::now( );
+			}
+		}
+
+		enum class call_phase : std::size_t { total, decode, handler, serialize };
+		inline constexpr std::size_t call_phase_count = 4;
+
+		/// Latencies below 2^min_latency_bits ns share the first bucket, those
+		/// of 2^( max_latency_bits + 1 ) ns or more the last
+		inline constexpr std::size_t min_latency_bits = 10;
+		inline constexpr std::size_t max_latency_bits = 36;
+		/// Each power of two is split in to 2^sub_bucket_bits linear buckets
+		inline constexpr std::size_t sub_bucket_bits = 2;
+		inline constexpr std::size_t latency_bucket_count =
+		  1 + ( ( max_latency_bits - min_latency_bits + 1 ) << sub_bucket_bits );
+
+		struct histogram_snapshot {
+			std::array<std::uint64_t, latency_bucket_count> buckets{ };
+			std::uint64_t sum_ns = 0;
+			std::uint64_t count = 0;
+		};
+
+		struct metrics_snapshot {
+			std::string method;
+			std::uint64_t calls = 0;
+			std::vector<std::pair<int, std::uint64_t>> errors{ };
+			std::array<histogram_snapshot, call_phase_count> latencies{ };
+		};
+
+		/// @brief Per method counters and log-linear latency histograms.  Each
+		/// thread records into one of up to 16 cache line aligned shards, so few
+		/// threads contend on each counter
+		class method_metrics {
+			struct shard;
+			std::unique_ptr<shard[]> m_shards;
+
+			shard &local_shard( );
+
+		public:
+			method_metrics( );
+			~method_metrics( );
+
+			method_metrics( method_metrics const & ) = delete;
+			method_metrics &operator=( method_metrics const & ) = delete;
+
+			/// @brief Count a call and any error code found in its response
+			void record_call( std::string_view response );
+
+			/// @brief Count a call whose handler threw
+			void record_failed_call( int code );
+
+			void record_latency( call_phase phase, metrics_clock::duration d );
+
+			/// @brief Sum the shards
+			[[nodiscard]] metrics_snapshot snapshot( std::string method ) const;
+		};
+
+		/// @brief Append the metrics of each method in the Prometheus text
+		/// format
+		void write_prometheus( std::string &out,
+		                       std::vector<metrics_snapshot> const &methods );
+
+		/// @brief Is this call one of the timed samples
+		[[nodiscard]] bool should_sample( std::uint32_t sample_every );
+	} // namespace details
+} // namespace daw::json_rpc
@@ -0,0 +1,41 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <daw/daw_string_view.h>
+#include <daw/json/daw_json_link.h>
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace daw::json_rpc {
+	/// @brief A pre-serialized JSON value.  When returned from a handler it is
+	/// written into the response as the result verbatim, so it must be valid
+	/// JSON.  An empty one is written as null
+	struct raw_json {
+		std::string json{ };
+	};
+
+	/// @brief When it is the only parameter of a handler, the handler receives
+	/// the request params undecoded.  It refers to the request document and is
+	/// only valid for the duration of the handler
+	struct raw_params {
+		std::optional<daw::json::json_value> value{ };
+
+		/// @brief The params JSON text, empty when the request had none
+		[[nodiscard]] daw::string_view json( ) const {
+			if( not value ) {
+				return { };
+			}
+			auto const sv = value->get_string_view( );
+			return daw::string_view( sv.data( ), sv.size( ) );
+		}
+	};
+} // namespace daw::json_rpc
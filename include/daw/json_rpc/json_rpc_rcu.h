@@ -0,0 +1,37 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <cstdint>
+
+// Epoch based reclamation for data that is read far more often than it is
+// replaced.  Readers publish the epoch they entered in to a slot owned by
+// their thread, so entering and leaving a read section touches no shared
+// cache line that other readers write to.  Writers publish a new version,
+// advance the epoch and free the old version once no reader that entered
+// before the advance is still active
+namespace daw::json_rpc::details {
+	/// @brief Marks the lifetime of a read section on the calling thread.  Read
+	/// sections nest
+	class rcu_read_guard {
+	public:
+		rcu_read_guard( );
+		~rcu_read_guard( );
+
+		rcu_read_guard( rcu_read_guard const & ) = delete;
+		rcu_read_guard &operator=( rcu_read_guard const & ) = delete;
+	};
+
+	/// @brief Advance the epoch after publishing a new version
+	/// @return The epoch that must be quiescent before the old version is freed
+	[[nodiscard]] std::uint64_t rcu_advance( );
+
+	/// @brief Have all read sections entered before epoch been left
+	[[nodiscard]] bool rcu_is_quiescent( std::uint64_t epoch );
+} // namespace daw::json_rpc::details
@@ -6,62 +6,244 @@
 
 #pragma once
 
+#include "json_rpc_async.h"
+#include "json_rpc_metrics.h"
 #include "json_rpc_params.h"
+#include "json_rpc_raw_json.h"
 #include "json_rpc_response.h"
+#include "json_rpc_response_writer.h"
 #include "json_rpc_server_request.h"
+#include "json_rpc_tracing.h"
 
+#include <daw/daw_string_view.h>
 #include <daw/json/daw_json_link.h>
 
 #include <functional>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace daw::json_rpc {
-	using callback_type =
-	  std::function<void( details::json_rpc_server_request, std::string & )>;
+	/// A handler writes its response to the buffer and returns an empty
+	/// deferred_response, or returns a pending one that is completed later
+	using callback_type = std::function<deferred_response(
+	  details::json_rpc_server_request const &, std::string & )>;
 
-	template<typename Result, typename... Parameters, typename Callback>
-	callback_type make_callback( Callback &&c ) {
-		return [c = DAW_FWD( c )]( details::json_rpc_server_request req,
-		                           std::string &buff ) -> void {
-			auto it = std::back_inserter( buff );
-			if( not req.params and sizeof...( Parameters ) != 0 ) {
-				daw::json::to_json(
-				  json_rpc_response_error( Error( -32602, "Invalid params" ), req.id ),
-				  it );
-				return;
+	namespace details {
+		/// @brief Serialize the handler result r.  Asynchronous results(tasks,
+		/// awaitables and std::future) are serialized when they complete and
+		/// returned through the deferred_response
+		template<typename Result, typename R>
+		deferred_response write_result( R &&r, details::raw_id_type const &id,
+		                                std::string &buff,
+		                                stream_sink const *sink = nullptr ) {
+			if constexpr( is_generator_v<std::remove_cvref_t<R>> ) {
+				write_stream_response( buff, r, id, sink );
+				return { };
+			} else if constexpr( is_async_result_v<Result> ) {
+				// The request document may be gone by the time the result is ready
+				auto resp = deferred_response::make( );
+				when_done( DAW_FWD( r ),
+				           [resp, id = copy_id( id )]( auto &&get_value ) {
+					           auto out = std::string( );
+					           try {
+						           write_result_response( out, get_value( ), id );
+					           } catch( ... ) {
+						           out.clear( );
+						           write_error_response(
+						             out, Error( -32603, "Error handling request" ), id );
+					           }
+					           resp.set_value( std::move( out ) );
+				           } );
+				return resp;
+			} else {
+				if constexpr( std::is_same_v<std::remove_cvref_t<R>, Result> ) {
+					write_result_response( buff, r, id );
+				} else {
+					write_result_response( buff, Result( DAW_FWD( r ) ), id );
+				}
+				return { };
+			}
+		}
+	} // namespace details
+
+	namespace details {
+		/// @brief How a handler parameter is decoded from the params.  Borrowed
+		/// parameters refer to the request document rather than copying out of it
+		/// and are only valid for the duration of a synchronous handler
+		template<typename T>
+		struct param_traits {
+			using storage_type = T;
+			static constexpr bool is_borrowed = false;
+
+			static T &&to_param( T &value ) {
+				return std::move( value );
+			}
+		};
+
+		/// The raw string, escapes are not processed
+		template<>
+		struct param_traits<std::string_view> {
+			using storage_type = std::string_view;
+			static constexpr bool is_borrowed = true;
+
+			static std::string_view to_param( std::string_view value ) {
+				return value;
+			}
+		};
+
+		/// The raw string, escapes are not processed
+		template<>
+		struct param_traits<daw::string_view> {
+			using storage_type = daw::string_view;
+			static constexpr bool is_borrowed = true;
+
+			static daw::string_view to_param( daw::string_view value ) {
+				return value;
+			}
+		};
+
+		/// The undecoded JSON value
+		template<>
+		struct param_traits<daw::json::json_value> {
+			using storage_type = daw::json::json_value;
+			static constexpr bool is_borrowed = true;
+
+			static daw::json::json_value to_param( daw::json::json_value value ) {
+				return value;
+			}
+		};
+
+		/// A JSON array whose elements are decoded lazily while iterating
+		template<typename T>
+		struct param_traits<daw::json::json_array_range<T>> {
+			using storage_type = daw::json::json_value;
+			static constexpr bool is_borrowed = true;
+
+			static daw::json::json_array_range<T>
+			to_param( daw::json::json_value const &value ) {
+				return daw::json::json_array_range<T>( value.get_string_view( ) );
 			}
-			try {
-				if constexpr( sizeof...( Parameters ) == 0 ) {
-					if( not req.params ) {
-						daw::json::to_json(
-						  json_rpc_response_result<Result>( c( ), req.id ), it );
-						return;
+		};
+
+		/// The whole of the params undecoded
+		template<>
+		struct param_traits<raw_params> {
+			using storage_type = raw_params;
+			static constexpr bool is_borrowed = true;
+
+			static raw_params to_param( raw_params value ) {
+				return value;
+			}
+		};
+
+		template<typename T>
+		using param_traits_t = param_traits<std::remove_cvref_t<T>>;
+
+		template<typename... Parameters>
+		inline constexpr bool takes_raw_params_v = false;
+
+		template<typename Parameter>
+		inline constexpr bool takes_raw_params_v<Parameter> =
+		  std::is_same_v<std::remove_cvref_t<Parameter>, raw_params>;
+
+		template<typename T>
+		using param_storage_t = typename param_traits_t<T>::storage_type;
+
+		/// @brief Marks where a handler call moves from decoding params to
+		/// running the handler to serializing its result, for metrics and tracing
+		class handler_phases {
+			span_scope m_span;
+
+		public:
+			explicit handler_phases( daw::string_view method )
+			  : m_span( span_kind::decode_params,
+			            std::string_view( method.data( ), method.size( ) ) ) {}
+
+			void params_decoded( ) {
+				mark_params_decoded( );
+				m_span.next( span_kind::run_handler );
+			}
+
+			void handler_returned( ) {
+				mark_handler_returned( );
+				m_span.next( span_kind::serialize_response );
+			}
+		};
+
+		/// @brief Decode the params of req, call c with them and serialize the
+		/// result to buff
+		template<typename Result, typename... Parameters, typename Callback>
+		deferred_response invoke_handler( Callback const &c,
+		                                  details::json_rpc_server_request const &req,
+		                                  std::string &buff ) {
+			static_assert(
+			  not is_async_result_v<Result> or
+			    ( not param_traits_t<Parameters>::is_borrowed and ... ),
+			  "Borrowed parameters refer to the request document, which does not "
+			  "outlive an asynchronous handler" );
+			auto phases = handler_phases( req.method );
+			if constexpr( takes_raw_params_v<Parameters...> ) {
+				phases.params_decoded( );
+				auto &&result = c( raw_params{ req.params } );
+				phases.handler_returned( );
+				return details::write_result<Result>( DAW_FWD( result ), req.id, buff,
+				                                      req.stream.get( ) );
+			} else {
+				if( not req.params and sizeof...( Parameters ) != 0 ) {
+					write_error_response( buff, Error( -32602, "Invalid params" ),
+					                      req.id );
+					return { };
+				}
+				try {
+					if constexpr( sizeof...( Parameters ) == 0 ) {
+						if( not req.params ) {
+							phases.params_decoded( );
+							auto &&result = c( );
+							phases.handler_returned( );
+							return details::write_result<Result>(
+							  DAW_FWD( result ), req.id, buff, req.stream.get( ) );
+						}
+					} else {
+						if( not req.params ) {
+							write_error_response( buff, Error( -32602, "Invalid params" ),
+							                      req.id );
+							return { };
+						}
 					}
-				} else {
-					if( not req.params ) {
-						daw::json::to_json( json_rpc_response_error(
-						                      Error( -32602, "Invalid params" ), req.id ),
-						                    it );
-						return;
+					auto p = daw::json::from_json<daw::json::json_tuple_no_name<
+					  std::tuple<param_storage_t<Parameters>...>>>( *req.params );
+					phases.params_decoded( );
+					auto &&result = std::apply(
+					  [&c]( auto &...args ) {
+						  return c( param_traits_t<Parameters>::to_param( args )... );
+					  },
+					  p );
+					phases.handler_returned( );
+					return details::write_result<Result>( DAW_FWD( result ), req.id,
+					                                      buff, req.stream.get( ) );
+				} catch( daw::json::json_exception const &je ) {
+					if( je.reason_type( ) == daw::json::ErrorReason::MissingMemberName ) {
+						write_error_response( buff, Error( -32602, "Invalid params" ),
+						                      req.id );
+					} else {
+						write_error_response( buff, Error( -32700, "Parse Error" ),
+						                      req.id );
 					}
 				}
-				auto p = daw::json::from_json<
-				  daw::json::json_tuple_no_name<std::tuple<Parameters...>>>(
-				  *req.params );
-				auto resp =
-				  json_rpc_response_result<Result>( std::apply( c, p ), req.id );
-				daw::json::to_json( resp, it );
-			} catch( daw::json::json_exception const &je ) {
-				if( je.reason_type( ) == daw::json::ErrorReason::MissingMemberName ) {
-					daw::json::to_json( json_rpc_response_error(
-					                      Error( -32602, "Invalid params" ), req.id ),
-					                    it );
-				}
-				daw::json::to_json(
-				  json_rpc_response_error( Error( -32700, "Parse Error" ), req.id ),
-				  it );
+				return { };
 			}
+		}
+	} // namespace details
+
+	template<typename Result, typename... Parameters, typename Callback>
+	callback_type make_callback( Callback &&c ) {
+		return [c = DAW_FWD( c )]( details::json_rpc_server_request const &req,
+		                           std::string &buff ) -> deferred_response {
+			return details::invoke_handler<Result, Parameters...>( c, req, buff );
 		};
 	}
 
@@ -81,9 +263,10 @@ namespace daw::json_rpc {
 		request_handler( Result ( *cb )( Args... ) )
 		  : m_callback( make_callback<Result, Args...>( cb ) ) {}
 
-		inline void operator( )( details::json_rpc_server_request req,
-		                         std::string &buff ) const {
-			m_callback( std::move( req ), buff );
+		inline deferred_response
+		operator( )( details::json_rpc_server_request const &req,
+		             std::string &buff ) const {
+			return m_callback( req, buff );
 		}
 
 		callback_type &callback( ) & {
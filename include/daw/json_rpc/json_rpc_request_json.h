@@ -11,6 +11,7 @@
 
 #include <daw/json/daw_json_link_types.h>
 
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -21,18 +22,20 @@ namespace daw::json {
 	inline static constexpr char const mem_jsonrpc[] = "jsonrpc";
 	inline static constexpr char const mem_method[] = "method";
 	inline static constexpr char const mem_params[] = "params";
+	inline static constexpr char const mem_timeout_ms[] = "timeout_ms";
 
 	template<>
 	struct json_data_contract<daw::json_rpc::details::json_rpc_server_request> {
-		using type = json_member_list<json_link<mem_jsonrpc, daw::string_view>,
-		                              json_link<mem_method, std::string>,
-		                              json_raw_null<mem_params>,
-		                              daw::json_rpc::details::id_json_map_type>;
+		using type = json_member_list<
+		  json_link<mem_jsonrpc, daw::string_view>,
+		  json_link<mem_method, daw::string_view>, json_raw_null<mem_params>,
+		  json_raw_null<daw::json_rpc::details::id_json_mem_name>,
+		  json_number_null<mem_timeout_ms, std::optional<std::int64_t>>>;
 
 		static inline auto to_json_data(
 		  daw::json_rpc::details::json_rpc_server_request const &value ) {
 			return std::forward_as_tuple( value.jsonrpc, value.method, value.params,
-			                              value.id );
+			                              value.id, value.timeout_ms );
 		}
 	};
 
@@ -0,0 +1,165 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include "json_rpc_common.h"
+#include "json_rpc_expected.h"
+#include "json_rpc_generator.h"
+#include "json_rpc_raw_json.h"
+#include "json_rpc_response.h"
+#include "json_rpc_stream.h"
+
+#include <daw/json/daw_json_link.h>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// The server writes the response envelope itself so that the id can be copied
+// verbatim from the request document instead of being decoded and re-encoded.
+// Values are serialized straight into the buffer, which daw_json_link appends
+// to in runs rather than a character at a time through an iterator
+namespace daw::json_rpc::details {
+	/// @brief Append the JSON text of a request id, null when there is none
+	inline void write_id( std::string &buff, raw_id_type const &id ) {
+		if( not id ) {
+			buff.append( "null" );
+			return;
+		}
+		auto const raw = id->get_string_view( );
+		if( id->type( ) == daw::json::JsonBaseParseTypes::String ) {
+			buff.push_back( '"' );
+			buff.append( raw.data( ), raw.size( ) );
+			buff.push_back( '"' );
+		} else {
+			buff.append( raw.data( ), raw.size( ) );
+		}
+	}
+
+	/// @brief Append an id previously copied with copy_id
+	inline void write_id( std::string &buff, std::string const &id_json ) {
+		buff.append( id_json );
+	}
+
+	/// @brief An owning copy of the JSON text of an id, for responses written
+	/// after the request document is gone
+	[[nodiscard]] inline std::string copy_id( raw_id_type const &id ) {
+		auto result = std::string( );
+		write_id( result, id );
+		return result;
+	}
+
+	/// @brief The start of response, a response written with the id copied to
+	/// id_json, up to and including its "id": member name.  Empty when
+	/// response does not end with that id
+	[[nodiscard]] inline std::string_view
+	response_before_id( std::string_view response, std::string_view id_json ) {
+		constexpr auto id_member = std::string_view( R"(,"id":)" );
+		if( not response.ends_with( '}' ) ) {
+			return { };
+		}
+		response.remove_suffix( 1 );
+		if( not response.ends_with( id_json ) ) {
+			return { };
+		}
+		response.remove_suffix( id_json.size( ) );
+		if( not response.ends_with( id_member ) ) {
+			return { };
+		}
+		return response;
+	}
+
+	/// @brief Ids must be a string, number or null
+	[[nodiscard]] inline bool is_valid_id( raw_id_type const &id ) {
+		return not id or id->type( ) == daw::json::JsonBaseParseTypes::String or
+		       id->type( ) == daw::json::JsonBaseParseTypes::Number;
+	}
+
+	template<typename Data, typename Id>
+	void write_error_response( std::string &buff, Error<Data> const &error,
+	                           Id const &id );
+
+	/// @brief Write a result response, or the error response of an expected
+	/// holding an error
+	template<typename Result, typename Id>
+	void write_result_response( std::string &buff, Result const &result,
+	                            Id const &id ) {
+		if constexpr( is_expected_v<Result> ) {
+			if( result.has_value( ) ) {
+				write_result_response( buff, *result, id );
+			} else {
+				write_error_response( buff, result.error( ), id );
+			}
+		} else {
+			buff.append( R"({"jsonrpc":"2.0","result":)" );
+			if constexpr( std::is_same_v<Result, raw_json> ) {
+				// A result is required, so an empty one is sent as null
+				if( result.json.empty( ) ) {
+					buff.append( "null" );
+				} else {
+					buff.append( result.json );
+				}
+			} else {
+				(void)daw::json::to_json( result, buff );
+			}
+			buff.append( R"(,"id":)" );
+			write_id( buff, id );
+			buff.push_back( '}' );
+		}
+	}
+
+	template<typename Data, typename Id>
+	void write_error_response( std::string &buff, Error<Data> const &error,
+	                           Id const &id ) {
+		buff.append( R"({"jsonrpc":"2.0","error":)" );
+		(void)daw::json::to_json( error, buff );
+		buff.append( R"(,"id":)" );
+		write_id( buff, id );
+		buff.push_back( '}' );
+	}
+
+	/// @brief Write the values of gen as the array result of a response as
+	/// they are produced.  With a sink, each stream_part_size bytes of values
+	/// are sent through it as a partial response and only the last part is
+	/// written to buff
+	template<typename T, typename Id>
+	void write_stream_response( std::string &buff, generator<T> &gen,
+	                            Id const &id, stream_sink const *sink ) {
+		constexpr auto prefix =
+		  std::string_view( R"({"jsonrpc":"2.0","result":[)" );
+		auto part = std::string( );
+		auto &out = sink ? part : buff;
+		out.append( prefix );
+		bool is_first = true;
+		for( auto const &value : gen ) {
+			if( not is_first ) {
+				out.push_back( ',' );
+			}
+			is_first = false;
+			(void)daw::json::to_json( value, out );
+			if( sink and out.size( ) >= stream_part_size ) {
+				out.append( R"(],"id":)" );
+				write_id( out, id );
+				out.append( R"(,"partial":true})" );
+				( *sink )( std::exchange( out, std::string( ) ) );
+				out.reserve( stream_part_size + stream_part_size / 4 );
+				out.append( prefix );
+				is_first = true;
+			}
+		}
+		out.append( R"(],"id":)" );
+		write_id( out, id );
+		out.push_back( '}' );
+		if( sink ) {
+			buff.append( part );
+		}
+	}
+} // namespace daw::json_rpc::details
@@ -0,0 +1,76 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include "json_rpc_common.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace daw::json_rpc {
+	/// @brief Caching of a method's results.  Only use with methods whose result
+	/// depends on nothing but their params
+	struct cache_options {
+		/// How long a result is served from the cache.  Zero disables caching
+		std::chrono::milliseconds ttl{ 0 };
+		/// Upper bound on the size of the cached responses
+		std::size_t max_bytes = 1024U * 1024U;
+		/// Number of independently locked shards the cache is split into
+		std::size_t shards = 8;
+	};
+
+	struct cache_stats {
+		std::uint64_t hits = 0;
+		std::uint64_t misses = 0;
+	};
+
+	namespace details {
+		/// @brief A sharded LRU of serialized result responses keyed by the
+		/// canonical params of a request.  Responses are stored without their id,
+		/// which is written from the request on each hit
+		class result_cache {
+			struct shard;
+
+			std::chrono::milliseconds m_ttl;
+			std::vector<std::unique_ptr<shard>> m_shards{ };
+			std::atomic<std::uint64_t> m_hits = 0;
+			std::atomic<std::uint64_t> m_misses = 0;
+
+			shard &get_shard( std::string_view key ) const;
+
+		public:
+			explicit result_cache( cache_options const &opts );
+			~result_cache( );
+
+			result_cache( result_cache const & ) = delete;
+			result_cache &operator=( result_cache const & ) = delete;
+
+			/// @brief The cache key for params_json, with whitespace outside of
+			/// strings removed
+			[[nodiscard]] static std::string make_key( std::string_view params_json );
+
+			/// @brief On a hit, append the cached response with id to buff
+			[[nodiscard]] bool try_write( std::string_view key, raw_id_type const &id,
+			                              std::string &buff );
+
+			/// @brief Cache response, a result response ending in an id that is
+			/// id_size bytes long.  Error responses are not cached
+			void insert( std::string key, std::string_view response,
+			             std::size_t id_size );
+
+			[[nodiscard]] cache_stats stats( ) const;
+		};
+	} // namespace details
+} // namespace daw::json_rpc
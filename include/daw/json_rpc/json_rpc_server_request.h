@@ -7,11 +7,15 @@
 #pragma once
 
 #include "json_rpc_common.h"
+#include "json_rpc_deadline.h"
 #include "json_rpc_params.h"
+#include "json_rpc_stream.h"
 
 #include <daw/json/daw_json_link_types.h>
 #include <daw/daw_move.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -21,12 +25,21 @@
 namespace daw::json_rpc::details {
 	// This is used by the server to two step the parsing process.
 	// First it parses enough to determine the method requested and then passes
-	// the params to the handler to parse
+	// the params to the handler to parse.  It does not own any of its members,
+	// they refer to the request document which must outlive it
 	struct json_rpc_server_request {
 		daw::string_view jsonrpc = "2.0";
-		std::string method{ };
+		daw::string_view method{ };
 		std::optional<daw::json::json_value> params{ };
-		details::id_type id{ };
+		details::raw_id_type id{ };
+		/// Extension member, milliseconds the caller will wait for the response
+		std::optional<std::int64_t> timeout_ms{ };
+		/// Not part of the document.  Set from timeout_ms and the transport's
+		/// deadline before the request is dispatched
+		deadline_type deadline{ };
+		/// Not part of the document.  Where the parts of a streamed result are
+		/// sent, when the transport supports it.  Never set for notifications
+		stream_sink_ptr stream{ };
 	};
 
 	// This is the client request sent to the server to process
@@ -57,4 +70,23 @@ namespace daw::json_rpc::details {
 	template<typename... Ts>
 	json_rpc_client_request( daw::string_view, std::tuple<Ts...>,
 	                         details::id_type ) -> json_rpc_client_request<Ts...>;
+
+	// The type a client serializes an argument as
+	template<typename T>
+	struct client_type_map {
+		using type = T;
+	};
+
+	template<std::size_t N>
+	struct client_type_map<char const [N]> {
+		using type = std::string;
+	};
+
+	template<std::size_t N>
+	struct client_type_map<char[N]> {
+		using type = std::string;
+	};
+
+	template<typename T>
+	using client_type_map_t = typename client_type_map<T>::type;
 } // namespace daw::json_rpc::details
@@ -0,0 +1,188 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include "daw/daw_function_traits.h"
+#include "daw/json_rpc/json_rpc_buffer_pool.h"
+#include "daw/json_rpc/json_rpc_dispatch.h"
+#include "daw/json_rpc/json_rpc_request_handler.h"
+#include "daw/json_rpc/json_rpc_response_writer.h"
+#include "daw/json_rpc/json_rpc_server_request.h"
+#include "daw/json_rpc/json_rpc_tracing.h"
+
+#include <daw/daw_string_view.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace daw::json_rpc {
+	namespace details {
+		template<std::size_t N>
+		struct method_name {
+			char value[N]{ };
+
+			constexpr method_name( char const ( &str )[N] ) {
+				std::copy_n( str, N, value );
+			}
+
+			[[nodiscard]] constexpr std::string_view view( ) const {
+				return std::string_view( value, N - 1 );
+			}
+		};
+
+		constexpr std::uint32_t method_hash( std::uint32_t seed,
+		                                     std::string_view name ) {
+			// FNV-1a
+			auto h = 2166136261U ^ seed;
+			for( char c : name ) {
+				h ^= static_cast<unsigned char>( c );
+				h *= 16777619U;
+			}
+			return h;
+		}
+
+		template<typename Result, typename Params>
+		struct static_invoker;
+
+		template<typename Result, typename... Params>
+		struct static_invoker<Result, daw::fwd_pack<Params...>> {
+			template<typename Handler>
+			static deferred_response call( Handler const &h,
+			                               json_rpc_server_request const &req,
+			                               std::string &buff ) {
+				return invoke_handler<Result, std::remove_cvref_t<Params>...>( h, req,
+				                                                             buff );
+			}
+		};
+	} // namespace details
+
+	/// @brief A method of a static_dispatch.  Handler is a function pointer or
+	/// captureless lambda whose signature is deduced
+	template<details::method_name Name, auto Handler>
+	struct method {
+		static constexpr std::string_view name = Name.view( );
+
+		static deferred_response call( details::json_rpc_server_request const &req,
+		                               std::string &buff ) {
+			using func_t =
+			  daw::func::function_traits<std::remove_cv_t<decltype( Handler )>>;
+			// Size of the last response, used to pre-size the next one
+			static constinit auto size_hint = std::atomic<std::size_t>( 0 );
+			return details::write_sized( size_hint, buff, [&]( std::string &b ) {
+				return details::static_invoker<
+				  typename func_t::result_t,
+				  typename func_t::params_t>::call( Handler, req, b );
+			} );
+		}
+	};
+
+	/// @brief A dispatcher for a set of methods known at compile time.  Method
+	/// lookup is a constexpr perfect hash of the name followed by a single
+	/// comparison, and handlers are called directly so they can be inlined.
+	/// Use it in place of json_rpc_dispatch when no methods are added at runtime
+	template<typename... Methods>
+	class static_dispatch {
+		static_assert( sizeof...( Methods ) > 0 );
+		static constexpr std::size_t method_count = sizeof...( Methods );
+		static constexpr std::array<std::string_view, method_count> names = {
+		  Methods::name... };
+		// A sparse table keeps the seed search short
+		static constexpr std::size_t table_size =
+		  std::bit_ceil( method_count * 4 );
+
+		struct hash_table {
+			std::uint32_t seed = 0;
+			// Index into names, method_count for an empty slot
+			std::array<std::size_t, table_size> slots{ };
+		};
+
+		// Search for a seed that maps every name to its own slot
+		static constexpr std::optional<hash_table> make_table( ) {
+			for( std::uint32_t seed = 0; seed < 100'000; ++seed ) {
+				auto result = hash_table{ seed };
+				result.slots.fill( method_count );
+				bool is_perfect = true;
+				for( std::size_t n = 0; n < method_count and is_perfect; ++n ) {
+					auto &slot =
+					  result.slots[details::method_hash( seed, names[n] ) &
+					               ( table_size - 1 )];
+					is_perfect = slot == method_count;
+					slot = n;
+				}
+				if( is_perfect ) {
+					return result;
+				}
+			}
+			return std::nullopt;
+		}
+
+		static constexpr auto table = make_table( );
+		static_assert( table.has_value( ),
+		               "Could not find a perfect hash for the method names.  Are "
+		               "they unique?" );
+
+		batch_options m_batch{ };
+
+		template<std::size_t... Is>
+		static deferred_response call( std::size_t idx,
+		                               details::json_rpc_server_request const &req,
+		                               std::string &buff,
+		                               std::index_sequence<Is...> ) {
+			auto result = deferred_response{ };
+			(void)( ( idx == Is and
+			          ( result = Methods::call( req, buff ), true ) ) or
+			        ... );
+			return result;
+		}
+
+	public:
+		static_dispatch( ) = default;
+
+		deferred_response operator( )( details::json_rpc_server_request const &req,
+		                               std::string &buff ) const {
+			auto const name =
+			  std::string_view( std::data( req.method ), std::size( req.method ) );
+			auto span = details::span_scope( span_kind::lookup_method, name );
+			auto const idx =
+			  table->slots[details::method_hash( table->seed, name ) &
+			               ( table_size - 1 )];
+			span.end( );
+			if( idx == method_count or names[idx] != name ) {
+				details::write_error_response(
+				  buff, Error( -32601, "Method not found" ), req.id );
+				return { };
+			}
+			return call( idx, req, buff, std::make_index_sequence<method_count>{ } );
+		}
+
+		/// @brief Process a single request or batch.  See
+		/// json_rpc_dispatch::process
+		[[nodiscard]] process_result process( daw::string_view json_doc,
+		                                      std::string &buff,
+		                                      deadline_type deadline = { } ) const {
+			return details::process_document( *this, m_batch, json_doc, buff,
+			                                  deadline );
+		}
+
+		/// @brief Set how the members of batch requests are executed
+		static_dispatch &set_batch_options( batch_options opts ) & {
+			m_batch = std::move( opts );
+			return *this;
+		}
+	};
+} // namespace daw::json_rpc
@@ -0,0 +1,146 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace daw::json_rpc {
+	struct static_file_options {
+		/// How long a resolved path is served before the file's modification
+		/// time is checked again
+		std::chrono::milliseconds revalidate_interval{ 1000 };
+		/// Files up to this size are kept in memory.  Larger files are streamed
+		/// from disk by the server without being read in to memory whole
+		std::size_t max_memory_file_size = 64U * 1024U;
+		/// Upper bound on the number of request paths remembered
+		std::size_t max_entries = 4096;
+		/// Largest part of a file sent for a range request.  Longer ranges are
+		/// shortened, and clients request the remainder as they need it
+		std::size_t max_range_size = 1024U * 1024U;
+	};
+
+	namespace details {
+		/// @brief A file resolved from a request path
+		struct static_file {
+			std::filesystem::path path{ };
+			std::uint64_t size = 0;
+			std::filesystem::file_time_type mtime{ };
+			/// The contents of a file no larger than max_memory_file_size, null for
+			/// larger files
+			std::shared_ptr<std::string const> contents{ };
+			/// Strong validator derived from the size and modification time
+			std::string etag{ };
+			/// The modification time, truncated to seconds as HTTP dates are
+			std::chrono::system_clock::time_point modified{ };
+			/// The modification time as an HTTP date
+			std::string last_modified{ };
+			/// Precompressed siblings, path with .gz or .br appended, when they
+			/// are at least as new as the file
+			std::shared_ptr<static_file const> gzip{ };
+			std::shared_ptr<static_file const> brotli{ };
+		};
+
+		/// @brief Formats tp as an IMF-fixdate, e.g. Sun, 06 Nov 1994 08:49:37 GMT
+		[[nodiscard]] std::string
+		format_http_date( std::chrono::system_clock::time_point tp );
+
+		/// @brief Parses an IMF-fixdate.  The obsolete formats are not accepted
+		[[nodiscard]] std::optional<std::chrono::system_clock::time_point>
+		parse_http_date( std::string_view date );
+
+		/// @brief Whether an If-None-Match header value matches etag, using the
+		/// weak comparison
+		[[nodiscard]] bool etag_matches( std::string_view if_none_match,
+		                                 std::string_view etag );
+
+		/// @brief Whether an Accept-Encoding header value allows coding
+		[[nodiscard]] bool accepts_encoding( std::string_view accept_encoding,
+		                                     std::string_view coding );
+
+		/// @brief The outcome of a Range header for a representation of a given
+		/// size.  Only a single byte range is honoured; a header that is invalid
+		/// or names several ranges is ignored and the full representation sent
+		struct byte_range {
+			enum class status_t { full, partial, unsatisfiable };
+
+			status_t status = status_t::full;
+			/// Offsets of the first and last byte, inclusive, when partial
+			std::uint64_t first = 0;
+			std::uint64_t last = 0;
+
+			[[nodiscard]] std::uint64_t size( ) const {
+				return last - first + 1;
+			}
+		};
+
+		[[nodiscard]] byte_range parse_range( std::string_view range,
+		                                      std::uint64_t size );
+
+		/// @brief Reads count bytes of the file at path starting at offset
+		[[nodiscard]] std::string
+		read_file_range( std::filesystem::path const &path, std::uint64_t offset,
+		                 std::uint64_t count );
+
+		/// @brief Maps request paths below a directory to the files they name.
+		/// Resolved paths are remembered, along with paths naming no file, and
+		/// revalidated against the file's modification time once every
+		/// revalidate_interval
+		class static_file_cache {
+			using clock_t = std::chrono::steady_clock;
+
+			struct entry {
+				std::shared_ptr<static_file const> file{ };
+				clock_t::time_point checked{ };
+			};
+
+			struct key_hash {
+				using is_transparent = void;
+
+				std::size_t operator( )( std::string_view key ) const noexcept {
+					return std::hash<std::string_view>{ }( key );
+				}
+			};
+
+			std::filesystem::path m_base;
+			std::optional<std::string> m_default_file;
+			static_file_options m_options;
+			std::mutex m_mutex{ };
+			std::unordered_map<std::string, entry, key_hash, std::equal_to<>>
+			  m_entries{ };
+
+			[[nodiscard]] std::shared_ptr<static_file const>
+			resolve( std::string const &rel_path ) const;
+
+			[[nodiscard]] std::shared_ptr<static_file const>
+			load( std::filesystem::path const &path ) const;
+
+		public:
+			/// @param base Directory files are served from
+			/// @param default_file File served for requests naming a directory
+			static_file_cache( std::filesystem::path const &base,
+			                   std::optional<std::string> default_file,
+			                   static_file_options opts );
+
+			/// @brief The file named by rel_path, a sanitized path relative to
+			/// the base directory.  Null when there is no such file
+			[[nodiscard]] std::shared_ptr<static_file const>
+			find( std::string const &rel_path );
+		};
+	} // namespace details
+} // namespace daw::json_rpc
@@ -0,0 +1,47 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace daw::json_rpc::details {
+	/// @brief Sends the parts of a streamed response as they are produced.  Each
+	/// part but the last is a response with a "partial":true member, whose
+	/// result array holds the next values.  The last part is a normal response
+	/// delivered like any other
+	using stream_sink = std::function<void( std::string )>;
+	using stream_sink_ptr = std::shared_ptr<stream_sink const>;
+
+	/// Size at which a part of a streamed response is sent
+	inline constexpr std::size_t stream_part_size = 64U * 1024U;
+
+	/// The sink of the transport dispatching on the calling thread.  Empty when
+	/// the transport cannot send a response in parts
+	inline thread_local stream_sink_ptr current_stream_sink{ };
+
+	/// @brief Makes sink the calling thread's stream sink for its lifetime
+	class stream_sink_scope {
+		stream_sink_ptr m_previous;
+
+	public:
+		explicit stream_sink_scope( stream_sink_ptr sink )
+		  : m_previous( std::exchange( current_stream_sink, std::move( sink ) ) ) {}
+
+		~stream_sink_scope( ) {
+			current_stream_sink = std::move( m_previous );
+		}
+
+		stream_sink_scope( stream_sink_scope const & ) = delete;
+		stream_sink_scope &operator=( stream_sink_scope const & ) = delete;
+	};
+} // namespace daw::json_rpc::details
@@ -0,0 +1,148 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <daw/daw_move.h>
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace daw::json_rpc {
+	/// @brief A lazily started coroutine returning a T.  Handlers can return a
+	/// task<T> to complete their response without blocking a server thread, and
+	/// tasks can co_await other tasks or awaitables
+	template<typename T>
+	class [[nodiscard]] task {
+	public:
+		struct promise_type {
+			std::variant<std::monostate, T, std::exception_ptr> result{ };
+			std::coroutine_handle<> continuation{ };
+			std::function<void( promise_type & )> on_done{ };
+
+			task get_return_object( ) {
+				return task(
+				  std::coroutine_handle<promise_type>::from_promise( *this ) );
+			}
+
+			std::suspend_always initial_suspend( ) noexcept {
+				return { };
+			}
+
+			struct final_awaiter {
+				bool await_ready( ) noexcept {
+					return false;
+				}
+
+				std::coroutine_handle<>
+				await_suspend( std::coroutine_handle<promise_type> h ) noexcept {
+					auto &p = h.promise( );
+					if( p.continuation ) {
+						return p.continuation;
+					}
+					if( p.on_done ) {
+						// on_done may destroy the coroutine frame, so it cannot be called
+						// from inside the promise
+						auto f = std::move( p.on_done );
+						f( p );
+					}
+					return std::noop_coroutine( );
+				}
+
+				void await_resume( ) noexcept {}
+			};
+
+			final_awaiter final_suspend( ) noexcept {
+				return { };
+			}
+
+			template<typename U>
+			void return_value( U &&value ) {
+				result.template emplace<1>( DAW_FWD( value ) );
+			}
+
+			void unhandled_exception( ) {
+				result.template emplace<2>( std::current_exception( ) );
+			}
+
+			T get( ) && {
+				if( result.index( ) == 2 ) {
+					std::rethrow_exception( std::get<2>( result ) );
+				}
+				return std::get<1>( std::move( result ) );
+			}
+		};
+
+	private:
+		std::coroutine_handle<promise_type> m_handle{ };
+
+		explicit task( std::coroutine_handle<promise_type> h )
+		  : m_handle( h ) {}
+
+	public:
+		task( task &&other ) noexcept
+		  : m_handle( std::exchange( other.m_handle, nullptr ) ) {}
+
+		task &operator=( task &&rhs ) noexcept {
+			if( this != &rhs ) {
+				if( m_handle ) {
+					m_handle.destroy( );
+				}
+				m_handle = std::exchange( rhs.m_handle, nullptr );
+			}
+			return *this;
+		}
+
+		task( task const & ) = delete;
+		task &operator=( task const & ) = delete;
+
+		~task( ) {
+			if( m_handle ) {
+				m_handle.destroy( );
+			}
+		}
+
+		bool await_ready( ) const noexcept {
+			return false;
+		}
+
+		std::coroutine_handle<>
+		await_suspend( std::coroutine_handle<> awaiting ) noexcept {
+			m_handle.promise( ).continuation = awaiting;
+			return m_handle;
+		}
+
+		T await_resume( ) {
+			return std::move( m_handle.promise( ) ).get( );
+		}
+
+		/// @brief Run the task without an awaiting coroutine.  on_done is called
+		/// with the promise when the task has finished and the coroutine frame is
+		/// destroyed after it returns
+		template<typename OnDone>
+		static void start( task t, OnDone on_done ) {
+			auto h = std::exchange( t.m_handle, nullptr );
+			h.promise( ).on_done = [h, on_done = std::move( on_done )](
+			                         promise_type &p ) mutable {
+				on_done( p );
+				h.destroy( );
+			};
+			h.resume( );
+		}
+	};
+
+	template<typename>
+	inline constexpr bool is_task_v = false;
+
+	template<typename T>
+	inline constexpr bool is_task_v<task<T>> = true;
+} // namespace daw::json_rpc
@@ -0,0 +1,110 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace daw::json_rpc {
+	/// @brief The lane a task is queued in.  Higher lanes are served first, but
+	/// every lane gets a share of the workers so that none are starved
+	enum class priority : unsigned char { high, normal, low };
+
+	inline constexpr std::size_t priority_count = 3;
+
+	struct lane_stats {
+		/// Tasks waiting to run
+		std::size_t queued = 0;
+		/// Tasks that have run
+		std::uint64_t completed = 0;
+		/// Tasks rejected by try_submit
+		std::uint64_t rejected = 0;
+	};
+
+	/// @brief A fixed size, work-stealing pool of worker threads.  Each worker
+	/// has its own queue per lane; tasks submitted from a worker stay on that
+	/// worker and idle workers steal from the others.  Destroying the pool waits
+	/// for queued tasks to complete
+	class thread_pool {
+		struct worker_queue {
+			std::mutex mutex{ };
+			std::array<std::deque<std::function<void( )>>, priority_count> lanes{ };
+		};
+
+		struct alignas( 64 ) lane_counters {
+			std::atomic<std::size_t> queued = 0;
+			std::atomic<std::uint64_t> completed = 0;
+			std::atomic<std::uint64_t> rejected = 0;
+		};
+
+		std::vector<std::unique_ptr<worker_queue>> m_queues{ };
+		std::vector<std::thread> m_threads{ };
+		std::size_t m_max_queued;
+		std::array<lane_counters, priority_count> m_lanes{ };
+		std::atomic<std::size_t> m_queued = 0;
+		std::atomic<std::size_t> m_next_queue = 0;
+		std::mutex m_sleep_mutex{ };
+		std::condition_variable m_cv{ };
+		bool m_stopping = false;
+
+		void worker( std::size_t index );
+		bool try_pop( std::size_t index, std::size_t lane,
+		              std::function<void( )> &task );
+		bool try_pop( std::size_t index, std::size_t turn,
+		              std::function<void( )> &task, std::size_t &lane );
+		void push( std::function<void( )> task, priority lane );
+
+	public:
+		static constexpr std::size_t unbounded =
+		  std::numeric_limits<std::size_t>::max( );
+
+		/// @param thread_count Number of worker threads
+		/// @param max_queued Number of queued tasks in a lane beyond which
+		/// try_submit fails for that lane
+		explicit thread_pool(
+		  std::size_t thread_count = std::thread::hardware_concurrency( ),
+		  std::size_t max_queued = unbounded );
+		~thread_pool( );
+
+		thread_pool( thread_pool && ) = delete;
+		thread_pool &operator=( thread_pool && ) = delete;
+		thread_pool( thread_pool const & ) = delete;
+		thread_pool &operator=( thread_pool const & ) = delete;
+
+		/// @brief Queue a task to be run on one of the pool threads, regardless of
+		/// the queue bound
+		void submit( std::function<void( )> task,
+		             priority lane = priority::normal );
+
+		/// @brief Queue a task unless max_queued tasks are already waiting in
+		/// its lane
+		/// @return false if the task was rejected
+		[[nodiscard]] bool try_submit( std::function<void( )> task,
+		                               priority lane = priority::normal );
+
+		/// @brief The number of worker threads in the pool
+		[[nodiscard]] std::size_t size( ) const;
+
+		/// @brief The number of tasks waiting to run
+		[[nodiscard]] std::size_t queued( ) const;
+
+		/// @brief Queue depth and counters of a lane
+		[[nodiscard]] lane_stats stats( priority lane ) const;
+	};
+} // namespace daw::json_rpc
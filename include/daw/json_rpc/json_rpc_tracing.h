@@ -0,0 +1,281 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace daw::json_rpc {
+	/// HTTP header carrying the W3C trace context between client and server
+	inline constexpr char const traceparent_header[] = "traceparent";
+
+	enum class span_kind : unsigned char {
+		/// Server: a request from receipt of its body until its response is
+		/// ready.  Client: a whole call
+		request,
+		parse_envelope,
+		lookup_method,
+		decode_params,
+		run_handler,
+		serialize_response,
+		/// Client: serializing the request
+		serialize_request,
+		/// Client: sending the request and receiving the response body
+		exchange,
+		/// Client: parsing the response and decoding its result
+		parse_response
+	};
+
+	using trace_id_type = std::array<std::uint8_t, 16>;
+	using span_id_type = std::array<std::uint8_t, 8>;
+
+	/// @brief A trace and a span within it, as carried by traceparent
+	struct trace_context {
+		trace_id_type trace_id{ };
+		span_id_type span_id{ };
+		std::uint8_t flags = 0;
+
+		/// @brief The trace id is set, i.e. not all zeros
+		[[nodiscard]] bool is_valid( ) const;
+	};
+
+	struct span_info {
+		span_kind kind = span_kind::request;
+		/// The method called, empty when not known yet
+		std::string_view method{ };
+		/// The trace and the id of this span
+		trace_context context{ };
+		/// All zeros for the first span of a trace
+		span_id_type parent_span_id{ };
+	};
+
+	/// @brief Receives the spans of requests.  Spans of a request may begin
+	/// and end on different threads, and an asynchronous handler's spans end
+	/// when it first returns rather than when its result is ready
+	class tracer {
+	public:
+		virtual ~tracer( );
+		virtual void begin_span( span_info const &span ) = 0;
+		virtual void end_span( span_info const &span ) = 0;
+	};
+
+	/// @brief Parse a traceparent header value.  Empty when it is not a valid
+	/// version 00 value
+	[[nodiscard]] std::optional<trace_context>
+	parse_traceparent( std::string_view value );
+
+	/// @brief The traceparent header value identifying ctx
+	[[nodiscard]] std::string to_traceparent( trace_context const &ctx );
+
+	namespace this_request {
+		/// @brief The trace context of the span running on the calling thread.
+		/// Empty when the request is not traced
+		[[nodiscard]] std::optional<trace_context> trace( );
+	} // namespace this_request
+
+	namespace details {
+		/// Defining DAW_JSON_RPC_DISABLE_TRACING, e.g. with the CMake option
+		/// DAW_JSON_RPC_TRACING=OFF, removes the tracing hooks at compile time
+#if defined( DAW_JSON_RPC_DISABLE_TRACING )
+		inline constexpr bool tracing_enabled = false;
+#else
+		inline constexpr bool tracing_enabled = true;
+#endif
+
+		struct trace_state {
+			tracer *sink = nullptr;
+			/// span_id is the span new spans are children of
+			trace_context context{ };
+		};
+
+		inline thread_local trace_state current_trace{ };
+
+		/// @brief The calling thread's trace, to continue it on another thread
+		/// with a trace_scope
+		[[nodiscard]] inline trace_state capture_trace( ) {
+			if constexpr( tracing_enabled ) {
+				return current_trace;
+			} else {
+				return { };
+			}
+		}
+
+		[[nodiscard]] trace_context new_trace( );
+		[[nodiscard]] span_id_type new_span_id( );
+
+		/// @brief Makes sink the calling thread's tracer for its lifetime.  New
+		/// spans are children of parent, or begin a new trace when parent is
+		/// not valid.  A null sink disables tracing in the scope.  When neither
+		/// sink nor the thread has a tracer it costs a thread local load, and
+		/// nothing when tracing is disabled at compile time
+		template<bool Enabled>
+		class basic_trace_scope {
+			trace_state m_previous{ };
+			bool m_is_active = false;
+
+		public:
+			explicit basic_trace_scope( trace_state state ) {
+				// Without a tracer on either side there is nothing to change
+				if( not state.sink and not current_trace.sink ) {
+					return;
+				}
+				m_previous = current_trace;
+				m_is_active = true;
+				if( state.sink and not state.context.is_valid( ) ) {
+					state.context = new_trace( );
+				}
+				current_trace = state;
+			}
+
+			basic_trace_scope( tracer *sink, std::optional<trace_context> parent )
+			  : basic_trace_scope(
+			      trace_state{ sink, parent.value_or( trace_context{ } ) } ) {}
+
+			~basic_trace_scope( ) {
+				if( m_is_active ) {
+					current_trace = m_previous;
+				}
+			}
+
+			basic_trace_scope( basic_trace_scope const & ) = delete;
+			basic_trace_scope &operator=( basic_trace_scope const & ) = delete;
+		};
+
+		template<>
+		class basic_trace_scope<false> {
+		public:
+			explicit basic_trace_scope( trace_state ) {}
+			basic_trace_scope( tracer *, std::optional<trace_context> ) {}
+		};
+
+		using trace_scope = basic_trace_scope<tracing_enabled>;
+
+		/// @brief A span that was begun on one thread and is ended on another,
+		/// once when end( ) is called or it is destroyed
+		template<bool Enabled>
+		class basic_detached_span {
+			tracer *m_sink = nullptr;
+			span_info m_span{ };
+
+		public:
+			basic_detached_span( ) = default;
+			basic_detached_span( tracer *sink, span_info const &span )
+			  : m_sink( sink )
+			  , m_span( span ) {}
+
+			basic_detached_span( basic_detached_span &&other ) noexcept
+			  : m_sink( std::exchange( other.m_sink, nullptr ) )
+			  , m_span( other.m_span ) {}
+
+			basic_detached_span &operator=( basic_detached_span && ) = delete;
+
+			~basic_detached_span( ) {
+				end( );
+			}
+
+			void end( ) {
+				if( auto *sink = std::exchange( m_sink, nullptr ); sink ) {
+					sink->end_span( m_span );
+				}
+			}
+		};
+
+		template<>
+		class basic_detached_span<false> {
+		public:
+			void end( ) {}
+		};
+
+		using detached_span = basic_detached_span<tracing_enabled>;
+
+		/// @brief Traces a span of the calling thread's trace for its lifetime.
+		/// Spans begun while it is alive are its children.  When the thread has
+		/// no tracer it costs a thread local load and initializing its members,
+		/// and nothing when tracing is disabled at compile time
+		template<bool Enabled>
+		class basic_span_scope {
+			tracer *m_sink = nullptr;
+			span_info m_span{ };
+
+			void begin( span_kind kind, std::string_view method ) {
+				m_sink = current_trace.sink;
+				m_span.kind = kind;
+				m_span.method = method;
+				m_span.context = current_trace.context;
+				m_span.context.span_id = new_span_id( );
+				m_span.parent_span_id = current_trace.context.span_id;
+				current_trace.context.span_id = m_span.context.span_id;
+				m_sink->begin_span( m_span );
+			}
+
+			void restore( ) {
+				current_trace.context.span_id = m_span.parent_span_id;
+			}
+
+		public:
+			explicit basic_span_scope( span_kind kind,
+			                           std::string_view method = { } ) {
+				if( current_trace.sink ) {
+					begin( kind, method );
+				}
+			}
+
+			~basic_span_scope( ) {
+				end( );
+			}
+
+			basic_span_scope( basic_span_scope const & ) = delete;
+			basic_span_scope &operator=( basic_span_scope const & ) = delete;
+
+			/// @brief End the span before the scope does
+			void end( ) {
+				if( m_sink ) {
+					restore( );
+					std::exchange( m_sink, nullptr )->end_span( m_span );
+				}
+			}
+
+			/// @brief End this span and begin its next sibling
+			void next( span_kind kind ) {
+				if( m_sink ) {
+					end( );
+					begin( kind, m_span.method );
+				}
+			}
+
+			/// @brief Stop being the parent of new spans on this thread and hand
+			/// ending the span to the returned object
+			[[nodiscard]] basic_detached_span<Enabled> detach( ) {
+				if( not m_sink ) {
+					return { };
+				}
+				restore( );
+				return { std::exchange( m_sink, nullptr ), m_span };
+			}
+		};
+
+		template<>
+		class basic_span_scope<false> {
+		public:
+			explicit basic_span_scope( span_kind, std::string_view = { } ) {}
+			void end( ) {}
+			void next( span_kind ) {}
+
+			[[nodiscard]] basic_detached_span<false> detach( ) {
+				return { };
+			}
+		};
+
+		using span_scope = basic_span_scope<tracing_enabled>;
+	} // namespace details
+} // namespace daw::json_rpc
@@ -8,51 +8,76 @@
 
 #pragma once
 
+#include "json_rpc/json_rpc_deadline.h"
 #include "json_rpc/json_rpc_request_json.h"
 #include "json_rpc/json_rpc_response.h"
+#include "json_rpc/json_rpc_tracing.h"
 
 #include <daw/curl_wrapper.h>
 #include <daw/daw_fwd_pack_apply.h>
 #include <daw/json/daw_json_link.h>
 
+#include <chrono>
+#include <memory>
+#include <optional>
 #include <string>
 
 namespace daw::json_rpc {
-	namespace details {
-		template<typename T>
-		struct client_type_map {
-			using type = T;
-		};
-
-		template<std::size_t N>
-		struct client_type_map<char const [N]> {
-			using type = std::string;
-		};
-
-		template<std::size_t N>
-		struct client_type_map<char[N]> {
-			using type = std::string;
-		};
-
-		template<typename T>
-		using client_type_map_t = typename client_type_map<T>::type;
-	} // namespace details
+	/// @brief Per call options of json_rpc_client
+	struct call_options {
+		/// How long the caller will wait.  Sent to the server, which drops the
+		/// request if it is still waiting to run when the time has passed
+		std::optional<std::chrono::milliseconds> timeout{ };
+		/// Trace the call.  Calls made while handling a traced request are traced
+		/// as part of that request's trace without it
+		std::shared_ptr<tracer> tracing{ };
+	};
 
 	template<typename Result, typename... Args>
 	json_rpc_response<Result>
-	json_rpc_client( std::string const &uri, std::string const &method_name,
-	                 details::req_id_type id, Args const &...args ) {
+	json_rpc_client( call_options const &opts, std::string const &uri,
+	                 std::string const &method_name, details::req_id_type id,
+	                 Args const &...args ) {
+		auto trace_state = details::capture_trace( );
+		if( opts.tracing ) {
+			trace_state.sink = opts.tracing.get( );
+		}
+		auto const trace = details::trace_scope( trace_state );
+		auto const span = details::span_scope( span_kind::request, method_name );
+		auto span_phase =
+		  details::span_scope( span_kind::serialize_request, method_name );
 		auto req = details::json_rpc_client_request(
 		  method_name, std::tuple<details::client_type_map_t<Args>...>{ args... },
 		  id );
 		auto req_json = daw::json::to_json( req );
+		span_phase.next( span_kind::exchange );
 		auto client = daw::curl_wrapper( );
 		client.add_header( "Content-Type", "application/json" );
+		if( opts.timeout ) {
+			client.add_header( request_timeout_header,
+			                   std::to_string( opts.timeout->count( ) ) );
+		}
+		if constexpr( details::tracing_enabled ) {
+			// The server's spans are children of the exchange span
+			if( details::current_trace.sink ) {
+				client.add_header( traceparent_header,
+				                   to_traceparent( details::current_trace.context ) );
+			}
+		}
 		client.set_body( req_json );
 		auto resp_str = client.get_string( uri );
+		span_phase.next( span_kind::parse_response );
 		return daw::json::from_json<json_rpc_response<Result>>( resp_str );
 	}
 
+	template<typename Result, typename... Args>
+	json_rpc_response<Result>
+	json_rpc_client( std::string const &uri, std::string const &method_name,
+	                 details::req_id_type id, Args const &...args ) {
+		return json_rpc_client<Result>( call_options{ }, uri, method_name,
+		                                std::move( id ), args... );
+	}
+
 	template<typename... Args>
 	void json_rpc_notification( std::string const &uri, std::string method_name,
 	                            Args const &...args ) {
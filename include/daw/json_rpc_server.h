@@ -8,7 +8,13 @@
 
 #pragma once
 
+#include "json_rpc/json_rpc_access_log.h"
+#include "json_rpc/json_rpc_compression.h"
 #include "json_rpc/json_rpc_dispatch.h"
+#include "json_rpc/json_rpc_embedded.h"
+#include "json_rpc/json_rpc_static_dispatch.h"
+#include "json_rpc/json_rpc_static_files.h"
+#include "json_rpc/json_rpc_tracing.h"
 
 #include <daw/daw_concepts.h>
 #include <daw/daw_string_view.h>
@@ -20,6 +26,7 @@
 #include <filesystem>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <type_traits>
 
@@ -41,6 +48,17 @@ namespace daw::json_rpc {
 
 	private:
 		crow::App<crow::CookieParser> server{ };
+		// Empty when no limit is set
+		std::unique_ptr<details::concurrency_limiter> m_admission{ };
+		std::shared_ptr<tracer> m_tracer{ };
+		std::shared_ptr<access_log> m_access_log{ };
+		std::optional<compression_options> m_compression{ };
+
+		json_rpc_server &
+		route_json_rpc( daw::string_view req_path,
+		                std::function<process_result( daw::string_view,
+		                                              std::string &, deadline_type )>
+		                  process ) &;
 
 	public:
 		json_rpc_server( );
@@ -63,14 +81,52 @@ namespace daw::json_rpc {
 		/// @brief Stop listening for connections and terminate existing connections
 		json_rpc_server &stop( ) &;
 
+		/// @brief Limit the number of JSON-RPC requests processed at once across
+		/// all JSON-RPC routes and WebSocket frames.  Requests beyond the limit
+		/// are answered with a -32000 "Server busy" error, over HTTP with a 503,
+		/// before they are parsed.  Must be set before listening
+		json_rpc_server &set_admission_options( admission_options opts ) &;
+
+		/// @brief Trace the JSON-RPC requests served, continuing the trace of a
+		/// request's traceparent header when it has one.  Must be set before
+		/// listening
+		json_rpc_server &set_tracer( std::shared_ptr<tracer> t ) &;
+
+		/// @brief Log each JSON-RPC request served, batch members included, with
+		/// its method, id, error code, latency and response size.  Must be set
+		/// before listening
+		json_rpc_server &set_access_log( std::shared_ptr<access_log> log ) &;
+
+		/// @brief Compress JSON-RPC responses of at least opts.min_size bytes
+		/// with gzip or deflate, when the request's Accept-Encoding allows it.
+		/// Must be set before listening
+		json_rpc_server &set_compression_options( compression_options opts ) &;
+
 		json_rpc_server &route_path_to(
 		  daw::string_view req_path, std::string const &method,
 		  std::function<void( crow::request const &, crow::response & )> handler )
 		  &;
 
+		/// @brief Serve the files below fs_base on GET requests under
+		/// req_path_prefix.  Resolved paths and small files are cached, see
+		/// static_file_options.  Conditional and single range requests are
+		/// honoured, and a sibling file.br or file.gz is sent in place of file
+		/// when the client accepts that encoding
 		json_rpc_server &
 		route_path_to( daw::string_view req_path_prefix,
 		               std::filesystem::path fs_base,
+		               std::optional<std::string> default_file = { },
+		               static_file_options opts = { } ) &;
+
+		/// @brief Serve the files of bundle on GET requests under
+		/// req_path_prefix, from memory and without touching the filesystem.
+		/// Conditional and single range requests are honoured, and the gzip
+		/// variant is sent when the client accepts it
+		/// @param bundle Must outlive the server
+		/// @param default_file File served for requests naming a directory
+		json_rpc_server &
+		route_path_to( daw::string_view req_path_prefix,
+		               embedded_bundle const &bundle,
 		               std::optional<std::string> default_file = { } ) &;
 
 		template<typename Result, typename Class>
@@ -88,6 +144,25 @@ namespace daw::json_rpc {
 		json_rpc_server &route_path_to( daw::string_view req_path,
 		                                json_rpc_dispatch &dispatcher ) &;
 
+		/// @brief Serve the metrics of dispatcher's methods in the Prometheus
+		/// text format on GET requests to req_path
+		/// @param dispatcher Must outlive the server
+		json_rpc_server &route_metrics( daw::string_view req_path,
+		                                json_rpc_dispatch const &dispatcher ) &;
+
+		template<typename... Methods>
+		json_rpc_server &
+		route_path_to( daw::string_view req_path,
+		               static_dispatch<Methods...> const &dispatcher ) & {
+			return route_json_rpc( req_path,
+			                       [&dispatcher]( daw::string_view json_doc,
+			                                      std::string &buff,
+			                                      deadline_type deadline ) {
+				                       return dispatcher.process( json_doc, buff,
+				                                                  deadline );
+			                       } );
+		}
+
 		json_rpc_server &websocket( daw::string_view req_path,
 		                            websocket_options opts ) {
 			auto &ws = server.route_dynamic( static_cast<std::string>( req_path ) )
@@ -105,11 +180,26 @@ namespace daw::json_rpc {
 				ws.onmessage( std::move( opts.on_message ) );
 			}
 			if( opts.on_open ) {
-				ws.onclose( std::move( opts.on_close ) );
+				ws.onopen( std::move( opts.on_open ) );
 			}
 			return *this;
 		}
 
+		/// @brief Serve JSON-RPC over a persistent WebSocket connection.  Each
+		/// text frame holds a single request or a batch and each response is sent
+		/// back as its own text frame.
+		/// @param req_path Path the WebSocket upgrade is accepted on
+		/// @param dispatcher Handlers for the requests.  Must outlive the server
+		/// @param pool When set, frames are processed on the pool so that many
+		/// requests can be in flight on a connection.  Responses are then sent as
+		/// they complete and are matched to requests by their id, and a frame that
+		/// the pool's queue has no room for is answered with a -32000 "Server
+		/// busy" error.  Without a pool, frames are processed in order on the
+		/// connection's I/O thread
+		json_rpc_server &websocket( daw::string_view req_path,
+		                            json_rpc_dispatch &dispatcher,
+		                            std::shared_ptr<thread_pool> pool = { } ) &;
+
 		cookie_t &get_cookie_context( crow::request const &req );
 	};
 } // namespace daw::json_rpc
\ No newline at end of file
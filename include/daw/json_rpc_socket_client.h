@@ -0,0 +1,72 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include "json_rpc/json_rpc_request_json.h"
+#include "json_rpc/json_rpc_response.h"
+
+#include <daw/json/daw_json_link.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+namespace daw::json_rpc {
+	/// @brief A connection to a socket_server.  Calls block until their
+	/// response arrives.  To pipeline, send several requests and then receive
+	/// their responses, matching them by id.  A client is not safe to use from
+	/// several threads at once
+	class socket_client {
+		struct impl_t;
+		std::unique_ptr<impl_t> m_impl;
+
+		explicit socket_client( std::unique_ptr<impl_t> impl );
+
+	public:
+		~socket_client( );
+		socket_client( socket_client && ) noexcept;
+		socket_client &operator=( socket_client && ) noexcept;
+
+		[[nodiscard]] static socket_client connect_tcp( std::string const &host,
+		                                                std::uint16_t port );
+
+		[[nodiscard]] static socket_client
+		connect_unix( std::filesystem::path const &path );
+
+		/// @brief Send a JSON-RPC document, a request or a batch.  It must be on
+		/// a single line
+		void send( std::string_view json_doc );
+
+		/// @brief The next response sent by the server, waiting for it if needed
+		[[nodiscard]] std::string receive( );
+
+		template<typename Result, typename... Args>
+		json_rpc_response<Result> call( std::string const &method_name,
+		                                details::req_id_type id,
+		                                Args const &...args ) {
+			auto req = details::json_rpc_client_request(
+			  method_name, std::tuple<details::client_type_map_t<Args>...>{ args... },
+			  std::move( id ) );
+			send( daw::json::to_json( req ) );
+			auto resp_str = receive( );
+			return daw::json::from_json<json_rpc_response<Result>>( resp_str );
+		}
+
+		template<typename... Args>
+		void notify( std::string const &method_name, Args const &...args ) {
+			auto req = details::json_rpc_client_request(
+			  method_name, std::tuple<details::client_type_map_t<Args>...>{ args... },
+			  { } );
+			send( daw::json::to_json( req ) );
+		}
+	};
+} // namespace daw::json_rpc
@@ -0,0 +1,84 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#pragma once
+
+#include "json_rpc/json_rpc_access_log.h"
+#include "json_rpc/json_rpc_admission.h"
+#include "json_rpc/json_rpc_dispatch.h"
+#include "json_rpc/json_rpc_tracing.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace daw::json_rpc {
+	struct socket_server_options {
+		/// Threads running the connections' I/O and synchronous handlers
+		std::size_t threads =
+		  std::max<std::size_t>( 1, std::thread::hardware_concurrency( ) );
+		/// A request longer than this closes its connection
+		std::size_t max_message_size = 16U * 1024U * 1024U;
+		/// Reading a connection's pipelined requests pauses while this many
+		/// bytes of its responses are waiting to be sent
+		std::size_t max_write_backlog = 4U * 1024U * 1024U;
+		/// Trace the requests served, each beginning a new trace
+		std::shared_ptr<tracer> tracing{ };
+		/// Log each request served, see json_rpc_server::set_access_log
+		std::shared_ptr<access_log> log{ };
+		/// Limit on the requests processed at once across all connections.
+		/// Requests beyond it are answered with a -32000 "Server busy" error
+		admission_options admission{ };
+	};
+
+	/// @brief Serves a json_rpc_dispatch over TCP and Unix domain sockets,
+	/// without HTTP.  Each request, a single request or a batch, is sent as
+	/// one line of JSON ending in '\n', and each response is sent back the same
+	/// way.  Requests can be pipelined.  Synchronous requests on a connection
+	/// are answered in order, while responses of asynchronous methods are sent
+	/// as they complete, so clients match responses by id.  Streamed results
+	/// are sent whole
+	class socket_server {
+		struct impl_t;
+		std::unique_ptr<impl_t> m_impl;
+
+	public:
+		/// @param dispatcher Must outlive the server, as must the asynchronous
+		/// requests it has in flight
+		explicit socket_server( json_rpc_dispatch const &dispatcher,
+		                        socket_server_options opts = { } );
+		~socket_server( );
+
+		socket_server( socket_server const & ) = delete;
+		socket_server &operator=( socket_server const & ) = delete;
+
+		/// @brief Accept connections on a TCP address.  Port 0 picks a free
+		/// port, see tcp_port
+		socket_server &listen_tcp( std::string const &host, std::uint16_t port ) &;
+
+		/// @brief Accept connections on a Unix domain socket.  A socket file
+		/// already at path is replaced, and the file is removed when the server
+		/// is destroyed
+		socket_server &listen_unix( std::filesystem::path const &path ) &;
+
+		/// @brief The port of the last TCP address listened on
+		[[nodiscard]] std::uint16_t tcp_port( ) const;
+
+		/// @brief Serve connections on opts.threads threads, the calling thread
+		/// being one of them, until stop is called
+		socket_server &run( ) &;
+
+		/// @brief Stop serving.  Safe to call from any thread, handlers
+		/// included
+		socket_server &stop( ) &;
+	};
+} // namespace daw::json_rpc
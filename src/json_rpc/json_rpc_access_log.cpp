@@ -0,0 +1,358 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_access_log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace daw::json_rpc {
+	inline namespace {
+		struct ring_cache_t {
+			std::uint64_t log_id = 0;
+			void *ring = nullptr;
+		};
+
+		// The ring of the log this thread last logged to
+		thread_local ring_cache_t ring_cache{ };
+
+		// Releases the rings of a thread when it exits, for other threads to
+		// reuse.  Each flag is the is_owned member of a ring, aliasing the ring
+		// so that the rings of a log destroyed first are not touched
+		struct owned_rings_t {
+			std::vector<std::weak_ptr<std::atomic<bool>>> flags{ };
+
+			~owned_rings_t( ) {
+				for( auto const &f : flags ) {
+					if( auto flag = f.lock( ); flag ) {
+						flag->store( false, std::memory_order_release );
+					}
+				}
+			}
+		};
+
+		thread_local owned_rings_t owned_rings{ };
+
+		std::atomic<std::uint64_t> next_log_id = 1;
+
+		template<typename Number>
+		void append_number( std::vector<char> &out, Number n ) {
+			char buff[32];
+			auto const r = std::to_chars( buff, buff + sizeof( buff ), n );
+			out.insert( out.end( ), buff, r.ptr );
+		}
+
+		void append_padded( std::vector<char> &out, unsigned n, int width ) {
+			char buff[16];
+			auto const r = std::to_chars( buff, buff + sizeof( buff ), n );
+			out.insert( out.end( ), width - ( r.ptr - buff ), '0' );
+			out.insert( out.end( ), buff, r.ptr );
+		}
+
+		void append( std::vector<char> &out, std::string_view str ) {
+			out.insert( out.end( ), str.begin( ), str.end( ) );
+		}
+
+		// Keeps a field a single token of the line
+		void append_field( std::vector<char> &out, std::string_view str ) {
+			if( str.empty( ) ) {
+				out.push_back( '-' );
+				return;
+			}
+			for( char c : str ) {
+				out.push_back(
+				  static_cast<unsigned char>( c ) <= ' ' or c == '\x7F' ? '_' : c );
+			}
+		}
+
+		// ISO 8601 in UTC with microseconds
+		void append_time( std::vector<char> &out,
+		                  std::chrono::system_clock::time_point tp ) {
+			using namespace std::chrono;
+			auto const day = floor<days>( tp );
+			auto const ymd = year_month_day( day );
+			auto const tod = hh_mm_ss( floor<microseconds>( tp - day ) );
+			append_padded( out, static_cast<unsigned>( int( ymd.year( ) ) ), 4 );
+			out.push_back( '-' );
+			append_padded( out, unsigned( ymd.month( ) ), 2 );
+			out.push_back( '-' );
+			append_padded( out, unsigned( ymd.day( ) ), 2 );
+			out.push_back( 'T' );
+			append_padded( out, static_cast<unsigned>( tod.hours( ).count( ) ), 2 );
+			out.push_back( ':' );
+			append_padded( out, static_cast<unsigned>( tod.minutes( ).count( ) ), 2 );
+			out.push_back( ':' );
+			append_padded( out, static_cast<unsigned>( tod.seconds( ).count( ) ), 2 );
+			out.push_back( '.' );
+			append_padded( out, static_cast<unsigned>( tod.subseconds( ).count( ) ),
+			               6 );
+			out.push_back( 'Z' );
+		}
+
+		void format_record( std::vector<char> &out, access_record const &r ) {
+			append_time( out, r.time );
+			append( out, " method=" );
+			append_field( out, std::string_view( r.method.data( ), r.method_size ) );
+			append( out, " id=" );
+			append_field( out, std::string_view( r.id.data( ), r.id_size ) );
+			append( out, " status=" );
+			append_number( out, r.status );
+			append( out, " latency_us=" );
+			append_number(
+			  out,
+			  std::chrono::duration_cast<std::chrono::microseconds>( r.latency )
+			    .count( ) );
+			append( out, " bytes=" );
+			append_number( out, r.bytes );
+			out.push_back( '\n' );
+		}
+
+		std::filesystem::path rotated_path( std::filesystem::path p,
+		                                    std::size_t n ) {
+			p += "." + std::to_string( n );
+			return p;
+		}
+
+		std::FILE *open_file( std::filesystem::path const &p, char const *mode ) {
+			auto *f = std::fopen( p.string( ).c_str( ), mode );
+			if( not f ) {
+				throw std::system_error( errno, std::generic_category( ),
+				                         "Unable to open access log " + p.string( ) );
+			}
+			return f;
+		}
+	} // namespace
+
+	void access_record::set_method( std::string_view m ) {
+		method_size =
+		  static_cast<std::uint8_t>( std::min( m.size( ), max_method_size ) );
+		std::copy_n( m.data( ), method_size, method.data( ) );
+	}
+
+	void access_record::set_id( std::string_view i ) {
+		id_size = static_cast<std::uint8_t>( std::min( i.size( ), max_id_size ) );
+		std::copy_n( i.data( ), id_size, id.data( ) );
+	}
+
+	// Single producer, the owning thread, and single consumer, the log thread.
+	// Once its thread has exited, a ring is taken over by the next thread to
+	// need one
+	struct access_log::ring {
+		std::unique_ptr<access_record[]> const records;
+		std::size_t const mask;
+		// Guarded by m_rings_mutex
+		std::thread::id owner{ };
+		// Only set under m_rings_mutex, but cleared by the owning thread
+		std::atomic<bool> is_owned = false;
+		alignas( 64 ) std::atomic<std::uint64_t> head = 0;
+		std::atomic<std::uint64_t> dropped = 0;
+		alignas( 64 ) std::atomic<std::uint64_t> tail = 0;
+
+		explicit ring( std::size_t size )
+		  : records( std::make_unique<access_record[]>( size ) )
+		  , mask( size - 1 ) {}
+	};
+
+	access_log::access_log( access_log_options opts )
+	  : m_options( std::move( opts ) )
+	  , m_id( next_log_id++ )
+	  , m_file( open_file( m_options.path, "ab" ) ) {
+		m_options.buffer_size =
+		  std::bit_ceil( std::max<std::size_t>( m_options.buffer_size, 2 ) );
+		auto ec = std::error_code( );
+		m_file_size = std::filesystem::file_size( m_options.path, ec );
+		if( ec ) {
+			m_file_size = 0;
+		}
+		m_thread = std::thread( [this] {
+			drain( );
+		} );
+	}
+
+	access_log::~access_log( ) {
+		{
+			auto lck = std::unique_lock( m_sleep_mutex );
+			m_stopping = true;
+		}
+		m_cv.notify_all( );
+		m_thread.join( );
+		if( m_file ) {
+			std::fclose( m_file );
+		}
+	}
+
+	access_log::ring &access_log::local_ring( ) {
+		if( ring_cache.log_id == m_id ) {
+			return *static_cast<ring *>( ring_cache.ring );
+		}
+		auto const id = std::this_thread::get_id( );
+		auto lck = std::unique_lock( m_rings_mutex );
+		auto pos =
+		  std::find_if( m_rings.begin( ), m_rings.end( ), [&]( auto const &r ) {
+			  return r->owner == id and r->is_owned.load( std::memory_order_relaxed );
+		  } );
+		if( pos != m_rings.end( ) ) {
+			ring_cache = { m_id, pos->get( ) };
+			return **pos;
+		}
+		// A ring is reused once the records of its exited thread are written.
+		// The acquire pairs with that thread's release, so its head is current
+		pos = std::find_if( m_rings.begin( ), m_rings.end( ), []( auto const &r ) {
+			return not r->is_owned.load( std::memory_order_acquire ) and
+			       r->head.load( std::memory_order_relaxed ) ==
+			         r->tail.load( std::memory_order_acquire );
+		} );
+		if( pos == m_rings.end( ) ) {
+			m_rings.push_back( std::make_shared<ring>( m_options.buffer_size ) );
+			pos = std::prev( m_rings.end( ) );
+		}
+		auto &r = **pos;
+		r.owner = id;
+		r.is_owned.store( true, std::memory_order_relaxed );
+		std::erase_if( owned_rings.flags,
+		               []( auto const &f ) { return f.expired( ); } );
+		owned_rings.flags.emplace_back(
+		  std::shared_ptr<std::atomic<bool>>( *pos, &r.is_owned ) );
+		ring_cache = { m_id, &r };
+		return r;
+	}
+
+	bool access_log::log( access_record const &record ) {
+		auto &r = local_ring( );
+		auto const head = r.head.load( std::memory_order_relaxed );
+		if( head - r.tail.load( std::memory_order_acquire ) > r.mask ) {
+			r.dropped.fetch_add( 1, std::memory_order_relaxed );
+			return false;
+		}
+		r.records[head & r.mask] = record;
+		r.head.store( head + 1, std::memory_order_release );
+		return true;
+	}
+
+	access_log_stats access_log::stats( ) const {
+		auto result = access_log_stats{ };
+		result.written = m_written.load( std::memory_order_relaxed );
+		result.failed = m_failed.load( std::memory_order_relaxed );
+		auto lck = std::unique_lock( m_rings_mutex );
+		for( auto const &r : m_rings ) {
+			result.dropped += r->dropped.load( std::memory_order_relaxed );
+		}
+		return result;
+	}
+
+	// Returns false when there was nothing to write
+	bool access_log::drain_once( std::vector<char> &out ) {
+		out.clear( );
+		auto written = std::uint64_t{ };
+		auto lck = std::unique_lock( m_rings_mutex );
+		for( auto const &r : m_rings ) {
+			auto const tail = r->tail.load( std::memory_order_relaxed );
+			auto const head = r->head.load( std::memory_order_acquire );
+			for( auto n = tail; n != head; ++n ) {
+				format_record( out, r->records[n & r->mask] );
+			}
+			r->tail.store( head, std::memory_order_release );
+			written += head - tail;
+		}
+		lck.unlock( );
+		if( written == 0 ) {
+			return false;
+		}
+		if( write( out ) ) {
+			m_written.fetch_add( written, std::memory_order_relaxed );
+		} else {
+			m_failed.fetch_add( written, std::memory_order_relaxed );
+		}
+		return true;
+	}
+
+	void access_log::drain( ) {
+		auto out = std::vector<char>( );
+		auto reported_drops = std::uint64_t{ };
+		auto lck = std::unique_lock( m_sleep_mutex );
+		while( true ) {
+			m_cv.wait_for( lck, m_options.flush_interval,
+			               [&] { return m_stopping; } );
+			bool const stopping = m_stopping;
+			lck.unlock( );
+			while( drain_once( out ) ) {}
+			if( auto const dropped = stats( ).dropped; dropped != reported_drops ) {
+				out.clear( );
+				append_time( out, std::chrono::system_clock::now( ) );
+				append( out, " dropped=" );
+				append_number( out, dropped - reported_drops );
+				out.push_back( '\n' );
+				(void)write( out );
+				reported_drops = dropped;
+			}
+			if( m_file ) {
+				std::fflush( m_file );
+			}
+			if( stopping ) {
+				return;
+			}
+			lck.lock( );
+		}
+	}
+
+	// A failed write loses the batch; the log must not stop the server
+	bool access_log::write( std::vector<char> const &out ) {
+		if( m_file and m_file_size > 0 and
+		    m_file_size + out.size( ) > m_options.max_file_size ) {
+			rotate( );
+		}
+		// Without a file, after rotating failed to open one, it is opened again
+		// at each write so that logging resumes once the cause is fixed
+		if( not m_file ) {
+			m_file = std::fopen( m_options.path.string( ).c_str( ), "ab" );
+			if( not m_file ) {
+				return false;
+			}
+			auto ec = std::error_code( );
+			m_file_size = std::filesystem::file_size( m_options.path, ec );
+			if( ec ) {
+				m_file_size = 0;
+			}
+		}
+		auto const size = std::fwrite( out.data( ), 1, out.size( ), m_file );
+		m_file_size += size;
+		return size == out.size( );
+	}
+
+	void access_log::rotate( ) {
+		std::fclose( m_file );
+		auto const &path = m_options.path;
+		m_file_size = 0;
+		if( m_options.max_files == 0 ) {
+			m_file = std::fopen( path.string( ).c_str( ), "wb" );
+			return;
+		}
+		auto ec = std::error_code( );
+		std::filesystem::remove( rotated_path( path, m_options.max_files ), ec );
+		for( auto n = m_options.max_files - 1; n > 0; --n ) {
+			std::filesystem::rename( rotated_path( path, n ),
+			                         rotated_path( path, n + 1 ), ec );
+		}
+		std::filesystem::rename( path, rotated_path( path, 1 ), ec );
+		m_file = std::fopen( path.string( ).c_str( ), "ab" );
+	}
+} // namespace daw::json_rpc
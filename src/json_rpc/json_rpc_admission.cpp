@@ -0,0 +1,112 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_admission.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <utility>
+
+namespace daw::json_rpc::details {
+	inline namespace {
+		// Shrinking from unlimited would take hundreds of slow requests before
+		// the limit meant anything, so an adaptive limit with no maximum starts
+		// from a window it can move away from quickly
+		std::size_t initial_limit( admission_options const &opts ) {
+			if( opts.target_latency.count( ) > 0 and
+			    opts.max_in_flight == admission_options::unlimited ) {
+				return std::max( opts.min_in_flight,
+				                 admission_options::initial_adaptive_limit );
+			}
+			return opts.max_in_flight;
+		}
+	} // namespace
+
+	concurrency_limiter::concurrency_limiter( admission_options const &opts )
+	  : m_limit( initial_limit( opts ) )
+	  , m_max( opts.max_in_flight )
+	  , m_min( std::min( opts.min_in_flight, opts.max_in_flight ) )
+	  , m_target_us( opts.target_latency.count( ) ) {}
+
+	void concurrency_limiter::configure( admission_options const &opts ) {
+		m_max = opts.max_in_flight;
+		m_min = std::min( opts.min_in_flight, opts.max_in_flight );
+		m_target_us = opts.target_latency.count( );
+		m_limit = initial_limit( opts );
+	}
+
+	bool concurrency_limiter::try_acquire( ) {
+		if( m_in_flight.fetch_add( 1, std::memory_order_relaxed ) >=
+		    m_limit.load( std::memory_order_relaxed ) ) {
+			m_in_flight.fetch_sub( 1, std::memory_order_relaxed );
+			return false;
+		}
+		return true;
+	}
+
+	// Additive increase, multiplicative decrease.  Updates racing with each
+	// other may be lost, which only slows the adjustment
+	void
+	concurrency_limiter::release( std::chrono::steady_clock::duration latency ) {
+		m_in_flight.fetch_sub( 1, std::memory_order_relaxed );
+		auto const target = m_target_us.load( std::memory_order_relaxed );
+		if( target <= 0 ) {
+			return;
+		}
+		auto const us =
+		  std::chrono::duration_cast<std::chrono::microseconds>( latency ).count( );
+		auto limit = m_limit.load( std::memory_order_relaxed );
+		auto next = limit;
+		if( us > target ) {
+			next = std::max( m_min.load( std::memory_order_relaxed ),
+			                 limit - std::max<std::size_t>( limit / 10, 1 ) );
+		} else if( limit < m_max.load( std::memory_order_relaxed ) ) {
+			next = limit + 1;
+		}
+		if( next != limit ) {
+			(void)m_limit.compare_exchange_weak( limit, next,
+			                                     std::memory_order_relaxed );
+		}
+	}
+
+	std::size_t concurrency_limiter::limit( ) const {
+		return m_limit;
+	}
+
+	std::size_t concurrency_limiter::in_flight( ) const {
+		return m_in_flight;
+	}
+
+	admission_ticket::admission_ticket( concurrency_limiter &limiter ) {
+		if( limiter.try_acquire( ) ) {
+			m_limiter = &limiter;
+			m_start = std::chrono::steady_clock::now( );
+		}
+	}
+
+	admission_ticket::admission_ticket( admission_ticket &&other ) noexcept
+	  : m_limiter( std::exchange( other.m_limiter, nullptr ) )
+	  , m_start( other.m_start ) {}
+
+	admission_ticket &
+	admission_ticket::operator=( admission_ticket &&other ) noexcept {
+		if( this != &other ) {
+			if( m_limiter ) {
+				m_limiter->release( std::chrono::steady_clock::now( ) - m_start );
+			}
+			m_limiter = std::exchange( other.m_limiter, nullptr );
+			m_start = other.m_start;
+		}
+		return *this;
+	}
+
+	admission_ticket::~admission_ticket( ) {
+		if( m_limiter ) {
+			m_limiter->release( std::chrono::steady_clock::now( ) - m_start );
+		}
+	}
+} // namespace daw::json_rpc::details
@@ -0,0 +1,118 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_async.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace daw::json_rpc {
+	deferred_response::deferred_response( std::shared_ptr<state_t> state )
+	  : m_state( std::move( state ) ) {}
+
+	deferred_response deferred_response::make( ) {
+		return deferred_response( std::make_shared<state_t>( ) );
+	}
+
+	bool deferred_response::is_pending( ) const {
+		return static_cast<bool>( m_state );
+	}
+
+	void deferred_response::set_value( std::string response ) const {
+		auto lck = std::unique_lock( m_state->mutex );
+		if( not m_state->on_ready ) {
+			m_state->value = std::move( response );
+			return;
+		}
+		auto f = std::move( m_state->on_ready );
+		lck.unlock( );
+		f( std::move( response ) );
+	}
+
+	void
+	deferred_response::on_ready( std::function<void( std::string )> f ) const {
+		auto lck = std::unique_lock( m_state->mutex );
+		if( not m_state->value ) {
+			m_state->on_ready = std::move( f );
+			return;
+		}
+		auto response = std::move( *m_state->value );
+		m_state->value.reset( );
+		lck.unlock( );
+		f( std::move( response ) );
+	}
+
+	namespace details {
+		inline namespace {
+			// A single thread that polls std::future results.  It backs off to
+			// sleeping up to 1ms between passes while nothing is completing and
+			// blocks when there is nothing to poll
+			class future_waiter {
+				std::mutex m_mutex{ };
+				std::condition_variable m_cv{ };
+				std::list<std::function<bool( )>> m_incoming{ };
+				std::thread m_thread;
+
+				void run( ) {
+					auto polls = std::list<std::function<bool( )>>{ };
+					auto delay = std::chrono::microseconds( 10 );
+					while( true ) {
+						{
+							auto lck = std::unique_lock( m_mutex );
+							if( polls.empty( ) ) {
+								m_cv.wait( lck, [&] {
+									return not m_incoming.empty( );
+								} );
+							}
+							polls.splice( polls.end( ), m_incoming );
+						}
+						auto const before = polls.size( );
+						polls.remove_if( []( auto &poll ) {
+							return poll( );
+						} );
+						if( polls.size( ) < before ) {
+							delay = std::chrono::microseconds( 10 );
+						} else {
+							std::this_thread::sleep_for( delay );
+							delay = std::min( delay * 2, std::chrono::microseconds( 1000 ) );
+						}
+					}
+				}
+
+			public:
+				future_waiter( )
+				  : m_thread( [this] {
+					  run( );
+				  } ) {
+					m_thread.detach( );
+				}
+
+				void add( std::function<bool( )> poll ) {
+					{
+						auto lck = std::unique_lock( m_mutex );
+						m_incoming.push_back( std::move( poll ) );
+					}
+					m_cv.notify_one( );
+				}
+			};
+		} // namespace
+
+		void when_ready( std::function<bool( )> poll ) {
+			// Intentionally leaked so that the detached thread never sees it
+			// destroyed during static destruction
+			static auto *waiter = new future_waiter( );
+			waiter->add( std::move( poll ) );
+		}
+	} // namespace details
+} // namespace daw::json_rpc
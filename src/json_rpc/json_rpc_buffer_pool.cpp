@@ -0,0 +1,41 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_buffer_pool.h"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace daw::json_rpc::details {
+	inline namespace {
+		constexpr std::size_t max_pooled_buffers = 16;
+		// Keeps one unusually large response from pinning memory in every thread
+		constexpr std::size_t max_pooled_capacity = 1024U * 1024U;
+
+		thread_local std::vector<std::string> free_buffers{ };
+	} // namespace
+
+	std::string acquire_buffer( std::size_t size_hint ) {
+		auto result = std::string( );
+		if( not free_buffers.empty( ) ) {
+			result = std::move( free_buffers.back( ) );
+			free_buffers.pop_back( );
+		}
+		result.reserve( size_hint );
+		return result;
+	}
+
+	void release_buffer( std::string &&buff ) {
+		if( buff.capacity( ) > max_pooled_capacity or
+		    free_buffers.size( ) >= max_pooled_buffers ) {
+			return;
+		}
+		buff.clear( );
+		free_buffers.push_back( std::move( buff ) );
+	}
+} // namespace daw::json_rpc::details
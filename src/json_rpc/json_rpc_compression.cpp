@@ -0,0 +1,122 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_compression.h"
+#include "daw/json_rpc/json_rpc_static_files.h"
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+namespace daw::json_rpc::details {
+	inline namespace {
+		// zlib's window bits select the framing: 15 for the zlib format HTTP
+		// calls deflate, and 16 more for gzip
+		constexpr int zlib_window_bits = 15;
+		constexpr int gzip_window_bits = 15 + 16;
+		constexpr int memory_level = 8;
+
+		class deflate_stream {
+			z_stream m_stream{ };
+			bool m_is_init = false;
+			int m_level = 0;
+
+		public:
+			deflate_stream( ) = default;
+			deflate_stream( deflate_stream const & ) = delete;
+			deflate_stream &operator=( deflate_stream const & ) = delete;
+
+			~deflate_stream( ) {
+				if( m_is_init ) {
+					deflateEnd( &m_stream );
+				}
+			}
+
+			// A stream used before is reset, keeping its buffers, unless the
+			// level changed
+			z_stream *get( int level, int window_bits ) {
+				if( m_is_init and m_level == level and
+				    deflateReset( &m_stream ) == Z_OK ) {
+					return &m_stream;
+				}
+				if( m_is_init ) {
+					deflateEnd( &m_stream );
+					m_is_init = false;
+				}
+				m_stream = z_stream{ };
+				if( deflateInit2( &m_stream, level, Z_DEFLATED, window_bits,
+				                  memory_level, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+					return nullptr;
+				}
+				m_is_init = true;
+				m_level = level;
+				return &m_stream;
+			}
+		};
+
+		thread_local deflate_stream gzip_stream{ };
+		thread_local deflate_stream zlib_stream{ };
+	} // namespace
+
+	content_coding select_coding( std::string_view accept_encoding ) {
+		if( accept_encoding.empty( ) ) {
+			return content_coding::identity;
+		}
+		if( accepts_encoding( accept_encoding, "gzip" ) ) {
+			return content_coding::gzip;
+		}
+		if( accepts_encoding( accept_encoding, "deflate" ) ) {
+			return content_coding::deflate;
+		}
+		return content_coding::identity;
+	}
+
+	char const *coding_name( content_coding coding ) {
+		switch( coding ) {
+		case content_coding::gzip:
+			return "gzip";
+		case content_coding::deflate:
+			return "deflate";
+		case content_coding::identity:
+			break;
+		}
+		return "identity";
+	}
+
+	bool compress( content_coding coding, int level, std::string_view in,
+	               std::string &out ) {
+		// A single deflate call is made, and zlib counts its input in uInt
+		if( coding == content_coding::identity or
+		    in.size( ) > std::numeric_limits<uInt>::max( ) ) {
+			return false;
+		}
+		auto *strm = coding == content_coding::gzip
+		               ? gzip_stream.get( level, gzip_window_bits )
+		               : zlib_stream.get( level, zlib_window_bits );
+		if( not strm ) {
+			return false;
+		}
+		auto const bound = deflateBound( strm, static_cast<uLong>( in.size( ) ) );
+		if( bound > std::numeric_limits<uInt>::max( ) ) {
+			return false;
+		}
+		out.resize( static_cast<std::size_t>( bound ) );
+		// zlib does not write through next_in
+		strm->next_in =
+		  reinterpret_cast<Bytef *>( const_cast<char *>( in.data( ) ) );
+		strm->avail_in = static_cast<uInt>( in.size( ) );
+		strm->next_out = reinterpret_cast<Bytef *>( out.data( ) );
+		strm->avail_out = static_cast<uInt>( out.size( ) );
+		if( deflate( strm, Z_FINISH ) != Z_STREAM_END ) {
+			out.clear( );
+			return false;
+		}
+		out.resize( static_cast<std::size_t>( strm->total_out ) );
+		return true;
+	}
+} // namespace daw::json_rpc::details
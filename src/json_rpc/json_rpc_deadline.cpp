@@ -0,0 +1,37 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_deadline.h"
+
+#include <utility>
+
+namespace daw::json_rpc {
+	inline namespace {
+		thread_local deadline_type current_deadline{ };
+	} // namespace
+
+	deadline_type this_request::deadline( ) {
+		return current_deadline;
+	}
+
+	deadline_clock::duration this_request::remaining( ) {
+		if( not current_deadline ) {
+			return deadline_clock::duration::max( );
+		}
+		return *current_deadline - deadline_clock::now( );
+	}
+
+	bool this_request::is_expired( ) {
+		return details::is_expired( current_deadline );
+	}
+
+	details::deadline_scope::deadline_scope( deadline_type deadline )
+	  : m_previous( std::exchange( current_deadline, deadline ) ) {}
+
+	details::deadline_scope::~deadline_scope( ) {
+		current_deadline = m_previous;
+	}
+} // namespace daw::json_rpc
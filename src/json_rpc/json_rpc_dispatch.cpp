@@ -6,41 +6,948 @@
 
 #include "daw/json_rpc/json_rpc_dispatch.h"
 #include "daw/daw_storage_ref.h"
+#include "daw/json_rpc/json_rpc_access_log.h"
+#include "daw/json_rpc/json_rpc_admission.h"
+#include "daw/json_rpc/json_rpc_buffer_pool.h"
+#include "daw/json_rpc/json_rpc_deadline.h"
+#include "daw/json_rpc/json_rpc_metrics.h"
+#include "daw/json_rpc/json_rpc_rcu.h"
+#include "daw/json_rpc/json_rpc_request_json.h"
+#include "daw/json_rpc/json_rpc_response_writer.h"
+#include "daw/json_rpc/json_rpc_result_cache.h"
+#include "daw/json_rpc/json_rpc_tracing.h"
+
 #include <daw/daw_construct_at.h>
+#include <daw/daw_string_view.h>
+#include <daw/json/daw_json_link.h>
 
-#include <iterator>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <latch>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace daw::json_rpc {
 	inline namespace {
+		// Allows looking up methods by a string_view into the request document
+		// without constructing a std::string
+		struct method_name_hash {
+			using is_transparent = void;
+
+			std::size_t operator( )( std::string_view name ) const noexcept {
+				return std::hash<std::string_view>{ }( name );
+			}
+		};
+
+		struct owned_request;
+
+		// Calls that are running, by their params, with the identical calls
+		// waiting on them
+		struct in_flight_calls {
+			struct waiter {
+				deferred_response resp;
+				// Kept to run the call again should the call waited on fail for
+				// reasons of its own
+				std::shared_ptr<owned_request> req;
+			};
+
+			std::mutex mutex{ };
+			std::unordered_map<std::string, std::vector<waiter>, method_name_hash,
+			                   std::equal_to<>>
+			  calls{ };
+		};
+
+		struct method_entry {
+			json_rpc::callback_type callback;
+			std::shared_ptr<thread_pool> pool{ };
+			priority lane = priority::normal;
+			// Size of the last response, used to pre-size the next one
+			mutable std::atomic<std::size_t> size_hint = 0;
+			std::unique_ptr<details::result_cache> cache{ };
+			std::unique_ptr<in_flight_calls> in_flight{ };
+			std::unique_ptr<details::concurrency_limiter> limiter{ };
+			// Empty when metrics were disabled as the method was added
+			std::unique_ptr<details::method_metrics> metrics{ };
+			std::uint32_t sample_every = 0;
+		};
+
+		// Tables are never modified once published.  Changes are made to a copy
+		// that replaces the published table, and the old table is freed once the
+		// requests that may be reading it are done
+		struct method_table {
+			std::unordered_map<std::string, std::shared_ptr<method_entry const>,
+			                   method_name_hash, std::equal_to<>>
+			  handlers{ };
+		};
+
 		struct impl_t {
-			std::unordered_map<std::string, json_rpc::callback_type> handlers{ };
+			struct retired_table {
+				std::uint64_t epoch;
+				std::unique_ptr<method_table const> table;
+			};
+
+			std::atomic<method_table const *> table = new method_table{ };
+			// Guards changes to the method table and the pools
+			mutable std::mutex write_mutex{ };
+			std::vector<retired_table> retired{ };
+			std::unordered_map<std::string, std::shared_ptr<thread_pool>> pools{ };
+			batch_options batch{ };
+			metrics_options metrics{ };
+
+			impl_t( ) = default;
+
+			impl_t( impl_t const &other ) {
+				auto lck = std::unique_lock( other.write_mutex );
+				delete table.exchange( new method_table( *other.table.load( ) ) );
+				pools = other.pools;
+				batch = other.batch;
+				metrics = other.metrics;
+			}
+
+			impl_t &operator=( impl_t const &other ) {
+				if( this == &other ) {
+					return *this;
+				}
+				auto lcks = std::scoped_lock( write_mutex, other.write_mutex );
+				publish( std::make_unique<method_table>( *other.table.load( ) ) );
+				pools = other.pools;
+				batch = other.batch;
+				metrics = other.metrics;
+				return *this;
+			}
+
+			~impl_t( ) {
+				delete table.load( );
+			}
+
+			// Must hold write_mutex
+			void publish( std::unique_ptr<method_table const> next ) {
+				auto prev = std::unique_ptr<method_table const>(
+				  table.exchange( next.release( ) ) );
+				retired.push_back( { details::rcu_advance( ), std::move( prev ) } );
+				std::erase_if( retired, []( retired_table const &r ) {
+					return details::rcu_is_quiescent( r.epoch );
+				} );
+			}
+
+			// Must hold write_mutex
+			[[nodiscard]] std::unique_ptr<method_table> copy_table( ) const {
+				return std::make_unique<method_table>( *table.load( ) );
+			}
 		};
 
 		inline constexpr auto get_ref =
 		  daw::storage_ref<impl_t, json_rpc_dispatch::storage_t>{ };
+
+		constexpr bool is_json_ws( char c ) {
+			return c == ' ' or c == '\t' or c == '\n' or c == '\r';
+		}
+
+		// A batch is a top level array, anything else is handled as a single
+		// request
+		constexpr bool is_batch( daw::string_view json_doc ) {
+			while( not json_doc.empty( ) and is_json_ws( json_doc.front( ) ) ) {
+				json_doc.remove_prefix( 1 );
+			}
+			return json_doc.starts_with( '[' );
+		}
+
+		void write_error( std::string &buff, int code, std::string message,
+		                  details::raw_id_type const &id = { } ) {
+			details::write_error_response( buff, Error( code, std::move( message ) ),
+			                               id );
+		}
+
+		// The error code of an error response, 0 for a result
+		int response_status( std::string_view response ) {
+			constexpr auto prefix =
+			  std::string_view( R"({"jsonrpc":"2.0","error":{"code":)" );
+			if( not response.starts_with( prefix ) ) {
+				return 0;
+			}
+			response.remove_prefix( prefix.size( ) );
+			int code = 0;
+			(void)std::from_chars( response.data( ),
+			                       response.data( ) + response.size( ), code );
+			return code;
+		}
+
+		// The request is copied so that it no longer refers to the document it
+		// was parsed from, which may be gone by the time the pool runs it
+		struct owned_request {
+			std::string method;
+			std::string params_json{ };
+			std::string id_json{ };
+			details::json_rpc_server_request req{ };
+
+			explicit owned_request( details::json_rpc_server_request const &r )
+			  : method( static_cast<std::string>( r.method ) ) {
+				req.method = method;
+				if( r.params ) {
+					params_json = static_cast<std::string>( r.params->get_string_view( ) );
+					req.params = daw::json::json_value( params_json );
+				}
+				if( r.id ) {
+					id_json = details::copy_id( r.id );
+					req.id = daw::json::json_value( id_json );
+				}
+				req.deadline = r.deadline;
+				req.stream = r.stream;
+			}
+
+			owned_request( owned_request const & ) = delete;
+			owned_request &operator=( owned_request const & ) = delete;
+		};
+
+		// Every call is counted.  Sampled calls are also timed, with
+		// invoke_handler marking where decoding the params ends and serializing
+		// the result begins
+		deferred_response
+		call_measured( std::shared_ptr<method_entry const> const &entry,
+		               details::json_rpc_server_request const &req,
+		               std::string &buff ) {
+			auto const invoke = [&]( std::string &b ) {
+				return entry->callback( req, b );
+			};
+			if( not entry->metrics ) {
+				return details::write_sized( entry->size_hint, buff, invoke );
+			}
+			using details::call_phase;
+			using clock = details::metrics_clock;
+			auto &metrics = *entry->metrics;
+			auto const sampled = details::should_sample( entry->sample_every );
+			auto timing = details::call_timing{ };
+			auto const start = sampled ? clock::now( ) : clock::time_point{ };
+			auto *const prev_timing = std::exchange( details::current_call_timing,
+			                                         sampled ? &timing : nullptr );
+			auto const pos = buff.size( );
+			auto resp = deferred_response{ };
+			try {
+				resp = details::write_sized( entry->size_hint, buff, invoke );
+			} catch( ... ) {
+				details::current_call_timing = prev_timing;
+				metrics.record_failed_call( -32603 );
+				throw;
+			}
+			details::current_call_timing = prev_timing;
+			if( not resp ) {
+				metrics.record_call( std::string_view( buff ).substr( pos ) );
+				if( sampled ) {
+					auto const end = clock::now( );
+					metrics.record_latency( call_phase::total, end - start );
+					// Params that failed to decode never reach the handler
+					if( timing.handled != clock::time_point{ } ) {
+						metrics.record_latency( call_phase::decode,
+						                        timing.decoded - start );
+						metrics.record_latency( call_phase::handler,
+						                        timing.handled - timing.decoded );
+						metrics.record_latency( call_phase::serialize,
+						                        end - timing.handled );
+					}
+				}
+				return { };
+			}
+			// Asynchronous results are serialized as they complete, so only the
+			// total is timed
+			auto result = deferred_response::make( );
+			resp.on_ready( [result, entry, sampled, start]( std::string r ) {
+				entry->metrics->record_call( r );
+				if( sampled ) {
+					entry->metrics->record_latency( call_phase::total,
+					                                clock::now( ) - start );
+				}
+				result.set_value( std::move( r ) );
+			} );
+			return result;
+		}
+
+		deferred_response
+		run_on_pool( std::shared_ptr<method_entry const> const &entry,
+		             details::json_rpc_server_request const &req,
+		             std::string &buff ) {
+			auto resp = deferred_response::make( );
+			auto owned = std::make_shared<owned_request>( req );
+			auto task = [resp, owned, entry, trace = details::capture_trace( )] {
+				auto out = std::string( );
+				// The request may have waited in the queue past its deadline
+				if( details::is_expired( owned->req.deadline ) ) {
+					write_error( out, -32002, "Deadline exceeded", owned->req.id );
+					resp.set_value( std::move( out ) );
+					return;
+				}
+				auto const scope = details::deadline_scope( owned->req.deadline );
+				auto const trace_scope = details::trace_scope( trace );
+				try {
+					if( auto d = call_measured( entry, owned->req, out ); d ) {
+						d.on_ready( [resp]( std::string r ) {
+							resp.set_value( std::move( r ) );
+						} );
+						return;
+					}
+				} catch( ... ) {
+					out.clear( );
+					write_error( out, -32603, "Error handling request", owned->req.id );
+				}
+				resp.set_value( std::move( out ) );
+			};
+			if( not entry->pool->try_submit( std::move( task ), entry->lane ) ) {
+				write_error( buff, -32000, "Server busy", req.id );
+				return { };
+			}
+			return resp;
+		}
+
+		deferred_response
+		call_method( std::shared_ptr<method_entry const> const &entry,
+		             details::json_rpc_server_request const &req,
+		             std::string &buff ) {
+			if( entry->pool ) {
+				return run_on_pool( entry, req, buff );
+			}
+			return call_measured( entry, req, buff );
+		}
+
+		// Errors that concern only the call that got them: its pool was full, or
+		// it waited in the pool's queue past its deadline.  A handler's own
+		// errors with these codes are treated the same
+		bool is_call_only_error( std::string_view response ) {
+			auto const code = response_status( response );
+			return code == -32000 or code == -32002;
+		}
+
+		deferred_response
+		call_coalesced( std::shared_ptr<method_entry const> const &entry,
+		                details::json_rpc_server_request const &req,
+		                std::string &buff );
+
+		// Each waiter runs the call itself, the first leading the others again
+		void retry_waiters( std::shared_ptr<method_entry const> const &entry,
+		                    std::vector<in_flight_calls::waiter> &waiters ) {
+			for( auto &w : waiters ) {
+				auto const &req = w.req->req;
+				auto out = std::string( );
+				if( details::is_expired( req.deadline ) ) {
+					write_error( out, -32002, "Deadline exceeded", req.id );
+					w.resp.set_value( std::move( out ) );
+					continue;
+				}
+				auto const scope = details::deadline_scope( req.deadline );
+				auto resp = deferred_response{ };
+				try {
+					resp = call_coalesced( entry, req, out );
+				} catch( ... ) {
+					out.clear( );
+					write_error( out, -32603, "Error handling request", req.id );
+				}
+				if( resp ) {
+					resp.on_ready(
+					  [result = w.resp, owned = w.req]( std::string r ) {
+						  result.set_value( std::move( r ) );
+					  } );
+					continue;
+				}
+				w.resp.set_value( std::move( out ) );
+			}
+		}
+
+		// Waiters get the response of the call they waited on with their own id.
+		// An empty response means the handler threw
+		void complete_waiters( std::shared_ptr<method_entry const> const &entry,
+		                       std::vector<in_flight_calls::waiter> &waiters,
+		                       std::string_view response,
+		                       std::string_view id_json ) {
+			if( waiters.empty( ) ) {
+				return;
+			}
+			if( response.empty( ) ) {
+				for( auto &w : waiters ) {
+					auto out = std::string( );
+					write_error( out, -32603, "Error handling request", w.req->req.id );
+					w.resp.set_value( std::move( out ) );
+				}
+				return;
+			}
+			auto const body = details::response_before_id( response, id_json );
+			if( body.empty( ) or is_call_only_error( response ) ) {
+				retry_waiters( entry, waiters );
+				return;
+			}
+			for( auto &w : waiters ) {
+				auto out = std::string( );
+				out.reserve( body.size( ) + w.req->id_json.size( ) + 5 );
+				out.append( body );
+				details::write_id( out, w.req->req.id );
+				out.push_back( '}' );
+				w.resp.set_value( std::move( out ) );
+			}
+		}
+
+		// While a call is running, identical calls wait for its response instead
+		// of running the handler again.  Calls join after passing admission, so a
+		// waiter only ever gets an error of the handler
+		deferred_response
+		call_coalesced( std::shared_ptr<method_entry const> const &entry,
+		                details::json_rpc_server_request const &req,
+		                std::string &buff ) {
+			auto key = details::result_cache::make_key(
+			  req.params ? req.params->get_string_view( ) : std::string_view( ) );
+			{
+				auto &flights = *entry->in_flight;
+				auto lck = std::unique_lock( flights.mutex );
+				if( auto pos = flights.calls.find( key ); pos != flights.calls.end( ) ) {
+					auto resp = deferred_response::make( );
+					pos->second.push_back(
+					  { resp, std::make_shared<owned_request>( req ) } );
+					return resp;
+				}
+				flights.calls.emplace( key, std::vector<in_flight_calls::waiter>{ } );
+			}
+			auto const finish = [entry, key = std::move( key ),
+			                     id_json = details::copy_id( req.id )](
+			                      std::string_view response ) {
+				auto &flights = *entry->in_flight;
+				auto lck = std::unique_lock( flights.mutex );
+				auto node = flights.calls.extract( key );
+				lck.unlock( );
+				complete_waiters( entry, node.mapped( ), response, id_json );
+			};
+			auto const start = buff.size( );
+			auto resp = deferred_response{ };
+			try {
+				resp = call_method( entry, req, buff );
+			} catch( ... ) {
+				finish( { } );
+				throw;
+			}
+			if( not resp ) {
+				finish( std::string_view( buff ).substr( start ) );
+				return { };
+			}
+			auto result = deferred_response::make( );
+			resp.on_ready( [result, finish]( std::string r ) {
+				finish( r );
+				result.set_value( std::move( r ) );
+			} );
+			return result;
+		}
+
+		deferred_response
+		call_admitted( std::shared_ptr<method_entry const> const &entry,
+		               details::json_rpc_server_request const &req,
+		               std::string &buff ) {
+			if( entry->in_flight ) {
+				return call_coalesced( entry, req, buff );
+			}
+			return call_method( entry, req, buff );
+		}
+
+		// Requests beyond the method's concurrency limit are rejected before their
+		// params are decoded
+		deferred_response
+		call_entry( std::shared_ptr<method_entry const> const &entry,
+		            details::json_rpc_server_request const &req,
+		            std::string &buff ) {
+			if( not entry->limiter ) {
+				return call_admitted( entry, req, buff );
+			}
+			auto ticket = details::admission_ticket( *entry->limiter );
+			if( not ticket ) {
+				write_error( buff, -32000, "Server busy", req.id );
+				return { };
+			}
+			auto resp = call_admitted( entry, req, buff );
+			if( not resp ) {
+				return { };
+			}
+			auto result = deferred_response::make( );
+			resp.on_ready(
+			  [result, ticket = std::make_shared<details::admission_ticket>(
+			             std::move( ticket ) )]( std::string r ) {
+				  result.set_value( std::move( r ) );
+			  } );
+			return result;
+		}
+
+		// Results are cached by their params, and a hit is written with the id of
+		// the request being served
+		deferred_response
+		call_cached_method( std::shared_ptr<method_entry const> const &entry,
+		                    details::json_rpc_server_request const &req,
+		                    std::string &buff ) {
+			auto key = details::result_cache::make_key(
+			  req.params ? req.params->get_string_view( ) : std::string_view( ) );
+			if( entry->cache->try_write( key, req.id, buff ) ) {
+				return { };
+			}
+			auto const start = buff.size( );
+			auto resp = call_entry( entry, req, buff );
+			auto const id_size = details::copy_id( req.id ).size( );
+			if( not resp ) {
+				entry->cache->insert( std::move( key ),
+				                      std::string_view( buff ).substr( start ), id_size );
+				return { };
+			}
+			auto result = deferred_response::make( );
+			resp.on_ready( [result, entry, key = std::move( key ),
+			                id_size]( std::string r ) mutable {
+				entry->cache->insert( std::move( key ), r, id_size );
+				result.set_value( std::move( r ) );
+			} );
+			return result;
+		}
+
+		// Notifications get no response, but an asynchronous handler must still be
+		// waited on before the batch holding it can complete
+		deferred_response discard( deferred_response const &resp ) {
+			auto result = deferred_response::make( );
+			resp.on_ready( [result]( std::string ) {
+				result.set_value( { } );
+			} );
+			return result;
+		}
+
+		struct document_context {
+			deadline_clock::time_point received = deadline_clock::now( );
+			// The deadline set by the transport, if any
+			deadline_type deadline{ };
+			access_log *log = details::current_access_log;
+			// Empty for batches, whose members are answered in a single array
+			details::stream_sink_ptr stream{ };
+		};
+
+		// Requests past their deadline are dropped before their params are
+		// decoded.  The caller has stopped waiting, so only an error is sent
+		deferred_response
+		run_request( details::dispatcher_ref dispatcher,
+		             details::json_rpc_server_request &req,
+		             document_context const &ctx, std::string &buff ) {
+			if( not details::is_valid_id( req.id ) ) {
+				write_error( buff, -32600, "Invalid Request" );
+				return { };
+			}
+			req.deadline =
+			  details::earliest_deadline( ctx.deadline, ctx.received, req.timeout_ms );
+			if( details::is_expired( req.deadline ) ) {
+				if( req.id ) {
+					write_error( buff, -32002, "Deadline exceeded", req.id );
+				}
+				return { };
+			}
+			// A notification has no response, so no parts of one are sent either
+			if( req.id ) {
+				req.stream = ctx.stream;
+			}
+			auto const scope = details::deadline_scope( req.deadline );
+			auto resp = dispatcher( req, buff );
+			if( req.id ) {
+				return resp;
+			}
+			buff.clear( );
+			if( resp ) {
+				return discard( resp );
+			}
+			return { };
+		}
+
+		void complete_record( access_record &record,
+		                      deadline_clock::time_point received,
+		                      std::string_view response ) {
+			record.time = std::chrono::system_clock::now( );
+			record.latency = deadline_clock::now( ) - received;
+			record.bytes = response.size( );
+			record.status = response_status( response );
+		}
+
+		// Each request of a document, batch members included, is logged once its
+		// response is ready
+		deferred_response
+		dispatch_request( details::dispatcher_ref dispatcher,
+		                  details::json_rpc_server_request &req,
+		                  document_context const &ctx, std::string &buff ) {
+			auto const start = buff.size( );
+			auto resp = run_request( dispatcher, req, ctx, buff );
+			if( not ctx.log ) {
+				return resp;
+			}
+			auto record = access_record{ };
+			record.set_method(
+			  std::string_view( req.method.data( ), req.method.size( ) ) );
+			if( req.id ) {
+				record.set_id( details::copy_id( req.id ) );
+			}
+			if( not resp ) {
+				complete_record(
+				  record, ctx.received,
+				  std::string_view( buff ).substr( std::min( start, buff.size( ) ) ) );
+				ctx.log->log( record );
+				return { };
+			}
+			auto result = deferred_response::make( );
+			resp.on_ready( [result, record, log = ctx.log,
+			                received = ctx.received]( std::string r ) mutable {
+				complete_record( record, received, r );
+				log->log( record );
+				result.set_value( std::move( r ) );
+			} );
+			return result;
+		}
+
+		deferred_response
+		process_batch_member( details::dispatcher_ref dispatcher,
+		                      daw::json::json_value const &member,
+		                      document_context const &ctx, std::string &buff ) {
+			auto req = details::json_rpc_server_request{ };
+			try {
+				auto const span = details::span_scope( span_kind::parse_envelope );
+				req = daw::json::from_json<details::json_rpc_server_request>( member );
+			} catch( daw::json::json_exception const & ) {
+				write_error( buff, -32600, "Invalid Request" );
+				return { };
+			}
+			try {
+				return dispatch_request( dispatcher, req, ctx, buff );
+			} catch( ... ) {
+				buff.clear( );
+				if( req.id ) {
+					write_error( buff, -32603, "Internal error", req.id );
+				}
+			}
+			return { };
+		}
+
+		// The calling thread and up to max_fan_out - 1 pool threads claim members
+		// until none are left.  Helpers that start after all members have been
+		// claimed do nothing, so the calling thread never waits on the pool
+		// itself and nested batches cannot deadlock it.
+		void run_batch_parallel( details::dispatcher_ref dispatcher,
+		                         batch_options const &opts,
+		                         document_context const &ctx,
+		                         std::vector<daw::json::json_value> const &members,
+		                         std::vector<std::string> &results,
+		                         std::vector<deferred_response> &pending ) {
+			struct batch_state {
+				std::size_t const count;
+				std::atomic<std::size_t> next = 0;
+				std::latch done;
+
+				explicit batch_state( std::size_t Count )
+				  : count( Count )
+				  , done( static_cast<std::ptrdiff_t>( Count ) ) {}
+			};
+			auto state = std::make_shared<batch_state>( members.size( ) );
+			// Members run on the helpers as part of the calling thread's trace.
+			// A helper starting after every member was claimed may outlive this
+			// call, so it only reads what it captured by value until it claims one
+			auto const work = [state, dispatcher, &ctx, &members, &results,
+			                   &pending, trace = details::capture_trace( ),
+			                   log = ctx.log] {
+				auto const trace_scope = details::trace_scope( trace );
+				auto const log_scope = details::access_log_scope( log );
+				for( auto idx = state->next++; idx < state->count;
+				     idx = state->next++ ) {
+					pending[idx] =
+					  process_batch_member( dispatcher, members[idx], ctx, results[idx] );
+					state->done.count_down( );
+				}
+			};
+			auto const helpers =
+			  std::min( { opts.max_fan_out, members.size( ), opts.pool->size( ) + 1 } ) -
+			  1;
+			for( std::size_t n = 0; n < helpers; ++n ) {
+				opts.pool->submit( work );
+			}
+			work( );
+			state->done.wait( );
+		}
+
+		// Notifications have empty results and are left out of the response.  If
+		// every member was a notification nothing is sent back
+		void join_batch( std::vector<std::string> const &results,
+		                 std::string &buff ) {
+			auto size = results.size( ) + 1;
+			for( auto const &r : results ) {
+				size += r.size( );
+			}
+			buff.reserve( buff.size( ) + size );
+			bool is_first = true;
+			for( auto const &r : results ) {
+				if( r.empty( ) ) {
+					continue;
+				}
+				buff.push_back( is_first ? '[' : ',' );
+				buff.append( r );
+				is_first = false;
+			}
+			if( not is_first ) {
+				buff.push_back( ']' );
+			}
+		}
+
+		// Completes once every asynchronous member has completed
+		deferred_response
+		join_batch_deferred( std::vector<std::string> results,
+		                     std::vector<deferred_response> const &pending ) {
+			struct join_state {
+				std::mutex mutex{ };
+				std::vector<std::string> results;
+				std::size_t remaining = 0;
+			};
+			auto state = std::make_shared<join_state>( );
+			state->results = std::move( results );
+			state->remaining = static_cast<std::size_t>(
+			  std::count_if( pending.begin( ), pending.end( ), []( auto const &p ) {
+				  return p.is_pending( );
+			  } ) );
+			auto result = deferred_response::make( );
+			for( std::size_t n = 0; n < pending.size( ); ++n ) {
+				if( not pending[n] ) {
+					continue;
+				}
+				pending[n].on_ready( [state, result, n]( std::string resp ) {
+					auto lck = std::unique_lock( state->mutex );
+					state->results[n] = std::move( resp );
+					if( --state->remaining != 0 ) {
+						return;
+					}
+					lck.unlock( );
+					auto buff = std::string( );
+					join_batch( state->results, buff );
+					result.set_value( std::move( buff ) );
+				} );
+			}
+			return result;
+		}
 	} // namespace
 
-	void
+	process_result details::process_document( dispatcher_ref dispatcher,
+	                                          batch_options const &opts,
+	                                          daw::string_view json_doc,
+	                                          std::string &buff,
+	                                          deadline_type deadline ) {
+		auto ctx = document_context{ deadline_clock::now( ), deadline };
+		if( not is_batch( json_doc ) ) {
+			ctx.stream = details::current_stream_sink;
+			auto req = details::json_rpc_server_request{ };
+			try {
+				auto const span = details::span_scope( span_kind::parse_envelope );
+				req = daw::json::from_json<details::json_rpc_server_request>(
+				  std::string_view( json_doc.data( ), json_doc.size( ) ) );
+			} catch( daw::json::json_exception const & ) {
+				write_error( buff, -32700, "Error handling request" );
+				return { false };
+			}
+			return { true, dispatch_request( dispatcher, req, ctx, buff ) };
+		}
+
+		auto members = std::vector<daw::json::json_value>{ };
+		try {
+			auto const span = details::span_scope( span_kind::parse_envelope );
+			auto doc = daw::json::json_value(
+			  std::string_view( json_doc.data( ), json_doc.size( ) ) );
+			for( auto jp : doc ) {
+				members.push_back( jp.value );
+			}
+		} catch( daw::json::json_exception const & ) {
+			write_error( buff, -32700, "Parse error" );
+			return { false };
+		}
+		if( members.empty( ) ) {
+			write_error( buff, -32600, "Invalid Request" );
+			return { };
+		}
+
+		// Member responses are written to pooled buffers, which are returned to
+		// the pool once joined
+		auto results = std::vector<std::string>( );
+		results.reserve( members.size( ) );
+		for( std::size_t n = 0; n < members.size( ); ++n ) {
+			results.push_back( details::acquire_buffer( ) );
+		}
+		auto pending = std::vector<deferred_response>( members.size( ) );
+		if( opts.pool and opts.max_fan_out > 1 and members.size( ) > 1 ) {
+			run_batch_parallel( dispatcher, opts, ctx, members, results, pending );
+		} else {
+			for( std::size_t n = 0; n < members.size( ); ++n ) {
+				pending[n] =
+				  process_batch_member( dispatcher, members[n], ctx, results[n] );
+			}
+		}
+		if( std::any_of( pending.begin( ), pending.end( ), []( auto const &p ) {
+			    return p.is_pending( );
+		    } ) ) {
+			return { true, join_batch_deferred( std::move( results ), pending ) };
+		}
+		join_batch( results, buff );
+		for( auto &r : results ) {
+			details::release_buffer( std::move( r ) );
+		}
+		return { };
+	}
+
+	deferred_response
 	json_rpc_dispatch::operator( )( details::json_rpc_server_request const &req,
 	                                std::string &buff ) const {
 
-		if( auto pos = get_ref( m_storage ).handlers.find( req.method );
-		    pos != get_ref( m_storage ).handlers.end( ) ) {
-			return pos->second( req, buff );
+		auto const guard = details::rcu_read_guard( );
+		auto const &handlers =
+		  get_ref( m_storage ).table.load( std::memory_order_acquire )->handlers;
+		auto const name =
+		  std::string_view( req.method.data( ), req.method.size( ) );
+		auto span = details::span_scope( span_kind::lookup_method, name );
+		auto const pos = handlers.find( name );
+		span.end( );
+		if( pos != handlers.end( ) ) {
+			auto const &entry = pos->second;
+			if( entry->cache ) {
+				return call_cached_method( entry, req, buff );
+			}
+			return call_entry( entry, req, buff );
+		}
+		write_error( buff, -32601, "Method not found", req.id );
+		return { };
+	}
+
+	process_result json_rpc_dispatch::process( daw::string_view json_doc,
+	                                           std::string &buff,
+	                                           deadline_type deadline ) const {
+		return details::process_document( *this, get_ref( m_storage ).batch,
+		                                  json_doc, buff, deadline );
+	}
+
+	cache_stats
+	json_rpc_dispatch::get_cache_stats( std::string_view method ) const {
+		auto const guard = details::rcu_read_guard( );
+		auto const &handlers =
+		  get_ref( m_storage ).table.load( std::memory_order_acquire )->handlers;
+		if( auto pos = handlers.find( method );
+		    pos != handlers.end( ) and pos->second->cache ) {
+			return pos->second->cache->stats( );
 		}
-		auto it = std::back_inserter( buff );
-		daw::json::to_json(
-		  json_rpc_response_error( Error( -32601, "Method not found" ), req.id ),
-		  it );
+		return { };
+	}
+
+	json_rpc_dispatch &
+	json_rpc_dispatch::set_batch_options( batch_options opts ) & {
+		get_ref( m_storage ).batch = std::move( opts );
+		return *this;
+	}
+
+	json_rpc_dispatch &
+	json_rpc_dispatch::set_metrics_options( metrics_options opts ) & {
+		auto &impl = get_ref( m_storage );
+		auto lck = std::unique_lock( impl.write_mutex );
+		impl.metrics = opts;
+		return *this;
+	}
+
+	void json_rpc_dispatch::write_metrics( std::string &out ) const {
+		auto snapshots = std::vector<details::metrics_snapshot>( );
+		{
+			auto const guard = details::rcu_read_guard( );
+			auto const &handlers =
+			  get_ref( m_storage ).table.load( std::memory_order_acquire )->handlers;
+			snapshots.reserve( handlers.size( ) );
+			for( auto const &[name, entry] : handlers ) {
+				if( entry->metrics ) {
+					snapshots.push_back( entry->metrics->snapshot( name ) );
+				}
+			}
+		}
+		std::sort( snapshots.begin( ), snapshots.end( ),
+		           []( auto const &lhs, auto const &rhs ) {
+			           return lhs.method < rhs.method;
+		           } );
+		details::write_prometheus( out, snapshots );
+	}
+
+	json_rpc_dispatch &json_rpc_dispatch::add_pool( std::string name,
+	                                                std::size_t thread_count,
+	                                                std::size_t max_queued ) & {
+		auto &impl = get_ref( m_storage );
+		auto pool = std::make_shared<thread_pool>( thread_count, max_queued );
+		auto lck = std::unique_lock( impl.write_mutex );
+		impl.pools.insert_or_assign( std::move( name ), std::move( pool ) );
+		return *this;
+	}
+
+	std::shared_ptr<thread_pool>
+	json_rpc_dispatch::get_pool( std::string_view name ) const {
+		auto &impl = get_ref( m_storage );
+		auto lck = std::unique_lock( impl.write_mutex );
+		for( auto const &[pool_name, pool] : impl.pools ) {
+			if( pool_name == name ) {
+				return pool;
+			}
+		}
+		return { };
 	}
 
 	void json_rpc_dispatch::add_method( std::string name,
-	                                    json_rpc::callback_type &&callback ) {
-		get_ref( m_storage )
-		  .handlers.insert_or_assign( std::move( name ), std::move( callback ) );
+	                                    json_rpc::callback_type &&callback,
+	                                    method_options &&opts,
+	                                    bool is_streamed ) {
+		// Only the last part of a result sent in parts is seen here, so it
+		// can be neither stored nor shared
+		if( is_streamed and opts.cache.ttl.count( ) > 0 ) {
+			throw std::invalid_argument( "Streamed method cannot be cached: " +
+			                             name );
+		}
+		if( is_streamed and opts.single_flight ) {
+			throw std::invalid_argument(
+			  "Streamed method cannot be single flight: " + name );
+		}
+		auto &impl = get_ref( m_storage );
+		auto entry = std::make_shared<method_entry>( );
+		entry->callback = std::move( callback );
+		auto lck = std::unique_lock( impl.write_mutex );
+		if( not opts.pool.empty( ) ) {
+			auto pos = impl.pools.find( opts.pool );
+			if( pos == impl.pools.end( ) ) {
+				throw std::invalid_argument( "Unknown pool: " + opts.pool );
+			}
+			entry->pool = pos->second;
+		}
+		entry->lane = opts.lane;
+		if( opts.cache.ttl.count( ) > 0 ) {
+			entry->cache = std::make_unique<details::result_cache>( opts.cache );
+		}
+		if( opts.single_flight ) {
+			entry->in_flight = std::make_unique<in_flight_calls>( );
+		}
+		if( details::is_admission_limited( opts.admission ) ) {
+			entry->limiter =
+			  std::make_unique<details::concurrency_limiter>( opts.admission );
+		}
+		if( impl.metrics.enabled ) {
+			entry->metrics = std::make_unique<details::method_metrics>( );
+			entry->sample_every = impl.metrics.sample_every;
+		}
+		auto next = impl.copy_table( );
+		next->handlers.insert_or_assign( std::move( name ), std::move( entry ) );
+		impl.publish( std::move( next ) );
+	}
+
+	json_rpc_dispatch &
+	json_rpc_dispatch::remove_method( std::string_view name ) & {
+		auto &impl = get_ref( m_storage );
+		auto lck = std::unique_lock( impl.write_mutex );
+		auto next = impl.copy_table( );
+		if( auto pos = next->handlers.find( name ); pos != next->handlers.end( ) ) {
+			next->handlers.erase( pos );
+			impl.publish( std::move( next ) );
+		}
+		return *this;
 	}
 
 	json_rpc_dispatch::json_rpc_dispatch( ) {
@@ -0,0 +1,285 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_metrics.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace daw::json_rpc::details {
+	inline namespace {
+		// A shard per hardware thread up to a bound, past which threads share
+		// shards.  Each shard holds a histogram per phase, about 3.5KB, so the
+		// bound keeps a method's metrics under 64KB on large hosts
+		constexpr std::size_t max_shard_count = 16;
+
+		// A function, as dispatchers may be created during static initialization
+		std::size_t shard_count( ) {
+			static std::size_t const count = std::bit_ceil( std::clamp<std::size_t>(
+			  std::thread::hardware_concurrency( ), 1, max_shard_count ) );
+			return count;
+		}
+
+		// Error codes tracked per shard.  The last slot stays code 0 and counts
+		// the codes that did not fit
+		constexpr std::size_t error_slots = 8;
+
+		constexpr std::string_view error_prefix =
+		  R"({"jsonrpc":"2.0","error":{"code":)";
+
+		std::size_t this_thread_shard( ) {
+			static std::atomic<std::size_t> next_shard = 0;
+			thread_local std::size_t const shard =
+			  next_shard.fetch_add( 1, std::memory_order_relaxed ) &
+			  ( shard_count( ) - 1 );
+			return shard;
+		}
+
+		std::size_t latency_bucket( std::uint64_t ns ) {
+			if( ns < ( std::uint64_t{ 1 } << min_latency_bits ) ) {
+				return 0;
+			}
+			auto const msb = static_cast<std::size_t>( std::bit_width( ns ) ) - 1;
+			if( msb > max_latency_bits ) {
+				return latency_bucket_count - 1;
+			}
+			auto const sub =
+			  static_cast<std::size_t>( ns >> ( msb - sub_bucket_bits ) ) &
+			  ( ( std::size_t{ 1 } << sub_bucket_bits ) - 1 );
+			return 1 + ( ( msb - min_latency_bits ) << sub_bucket_bits ) + sub;
+		}
+
+		struct histogram {
+			std::array<std::atomic<std::uint64_t>, latency_bucket_count> buckets{ };
+			std::atomic<std::uint64_t> sum_ns = 0;
+			std::atomic<std::uint64_t> count = 0;
+		};
+
+		struct error_slot {
+			// 0 when unused
+			std::atomic<int> code = 0;
+			std::atomic<std::uint64_t> count = 0;
+		};
+
+		void add( std::atomic<std::uint64_t> &counter, std::uint64_t n = 1 ) {
+			// Threads beyond shard_count share shards, and snapshot reads while
+			// they write.  The counters order nothing else, relaxed is enough
+			counter.fetch_add( n, std::memory_order_relaxed );
+		}
+
+		// The escapes required in a Prometheus label value
+		void append_label( std::string &out, std::string_view value ) {
+			for( char c : value ) {
+				switch( c ) {
+				case '\\':
+					out.append( "\\\\" );
+					break;
+				case '"':
+					out.append( "\\\"" );
+					break;
+				case '\n':
+					out.append( "\\n" );
+					break;
+				default:
+					out.push_back( c );
+				}
+			}
+		}
+
+		template<typename Number>
+		void append_number( std::string &out, Number n ) {
+			char buff[32];
+			auto const r = std::to_chars( buff, buff + sizeof( buff ), n );
+			out.append( buff, r.ptr );
+		}
+
+		constexpr std::array<std::string_view, call_phase_count> phase_names = {
+		  "total", "decode", "handler", "serialize" };
+	} // namespace
+
+	struct alignas( 64 ) method_metrics::shard {
+		std::atomic<std::uint64_t> calls = 0;
+		std::array<error_slot, error_slots> errors{ };
+		std::array<histogram, call_phase_count> latencies{ };
+	};
+
+	method_metrics::method_metrics( )
+	  : m_shards( std::make_unique<shard[]>( shard_count( ) ) ) {}
+
+	method_metrics::~method_metrics( ) = default;
+
+	method_metrics::shard &method_metrics::local_shard( ) {
+		return m_shards[this_thread_shard( )];
+	}
+
+	void method_metrics::record_call( std::string_view response ) {
+		if( not response.starts_with( error_prefix ) ) {
+			add( local_shard( ).calls );
+			return;
+		}
+		response.remove_prefix( error_prefix.size( ) );
+		int code = 0;
+		(void)std::from_chars( response.data( ), response.data( ) + response.size( ),
+		                       code );
+		record_failed_call( code );
+	}
+
+	void method_metrics::record_failed_call( int code ) {
+		auto &s = local_shard( );
+		add( s.calls );
+		for( std::size_t n = 0; n + 1 < error_slots; ++n ) {
+			auto &slot = s.errors[n];
+			auto expected = 0;
+			if( slot.code.load( std::memory_order_relaxed ) == code or
+			    slot.code.compare_exchange_strong( expected, code,
+			                                       std::memory_order_relaxed ) or
+			    expected == code ) {
+				add( slot.count );
+				return;
+			}
+		}
+		add( s.errors.back( ).count );
+	}
+
+	void method_metrics::record_latency( call_phase phase,
+	                                     metrics_clock::duration d ) {
+		auto const ns = static_cast<std::uint64_t>( std::max<std::int64_t>(
+		  std::chrono::duration_cast<std::chrono::nanoseconds>( d ).count( ), 0 ) );
+		auto &h = local_shard( ).latencies[static_cast<std::size_t>( phase )];
+		add( h.buckets[latency_bucket( ns )] );
+		add( h.sum_ns, ns );
+		add( h.count );
+	}
+
+	metrics_snapshot method_metrics::snapshot( std::string method ) const {
+		auto result = metrics_snapshot{ std::move( method ) };
+		for( std::size_t n = 0; n < shard_count( ); ++n ) {
+			auto const &s = m_shards[n];
+			result.calls += s.calls.load( std::memory_order_relaxed );
+			for( auto const &slot : s.errors ) {
+				auto const count = slot.count.load( std::memory_order_relaxed );
+				if( count == 0 ) {
+					continue;
+				}
+				auto const code = slot.code.load( std::memory_order_relaxed );
+				auto pos = std::find_if(
+				  result.errors.begin( ), result.errors.end( ),
+				  [&]( auto const &e ) { return e.first == code; } );
+				if( pos == result.errors.end( ) ) {
+					result.errors.emplace_back( code, count );
+				} else {
+					pos->second += count;
+				}
+			}
+			for( std::size_t p = 0; p < call_phase_count; ++p ) {
+				auto const &h = s.latencies[p];
+				auto &out = result.latencies[p];
+				for( std::size_t b = 0; b < latency_bucket_count; ++b ) {
+					out.buckets[b] += h.buckets[b].load( std::memory_order_relaxed );
+				}
+				out.sum_ns += h.sum_ns.load( std::memory_order_relaxed );
+				out.count += h.count.load( std::memory_order_relaxed );
+			}
+		}
+		return result;
+	}
+
+	void write_prometheus( std::string &out,
+	                       std::vector<metrics_snapshot> const &methods ) {
+		out.append( "# HELP jsonrpc_calls_total Handler calls by method.\n"
+		            "# TYPE jsonrpc_calls_total counter\n" );
+		for( auto const &m : methods ) {
+			out.append( "jsonrpc_calls_total{method=\"" );
+			append_label( out, m.method );
+			out.append( "\"} " );
+			append_number( out, m.calls );
+			out.push_back( '\n' );
+		}
+		out.append( "# HELP jsonrpc_errors_total Error responses by method and "
+		            "JSON-RPC error code.\n"
+		            "# TYPE jsonrpc_errors_total counter\n" );
+		for( auto const &m : methods ) {
+			for( auto const &[code, count] : m.errors ) {
+				out.append( "jsonrpc_errors_total{method=\"" );
+				append_label( out, m.method );
+				out.append( "\",code=\"" );
+				append_number( out, code );
+				out.append( "\"} " );
+				append_number( out, count );
+				out.push_back( '\n' );
+			}
+		}
+		// The sub buckets are summed in to one bucket per power of two to keep
+		// the output small
+		out.append( "# HELP jsonrpc_call_duration_seconds Sampled handler call "
+		            "latency by phase.\n"
+		            "# TYPE jsonrpc_call_duration_seconds histogram\n" );
+		for( auto const &m : methods ) {
+			for( std::size_t p = 0; p < call_phase_count; ++p ) {
+				auto const &h = m.latencies[p];
+				if( h.count == 0 ) {
+					continue;
+				}
+				auto const labels = [&] {
+					out.append( "{method=\"" );
+					append_label( out, m.method );
+					out.append( "\",phase=\"" );
+					out.append( phase_names[p] );
+					out.push_back( '"' );
+				};
+				std::uint64_t cumulative = h.buckets[0];
+				for( std::size_t bits = min_latency_bits; bits <= max_latency_bits;
+				     ++bits ) {
+					out.append( "jsonrpc_call_duration_seconds_bucket" );
+					labels( );
+					out.append( ",le=\"" );
+					append_number(
+					  out, static_cast<double>( std::uint64_t{ 1 } << bits ) * 1e-9 );
+					out.append( "\"} " );
+					append_number( out, cumulative );
+					out.push_back( '\n' );
+					auto const first =
+					  1 + ( ( bits - min_latency_bits ) << sub_bucket_bits );
+					for( std::size_t b = 0; b < ( std::size_t{ 1 } << sub_bucket_bits );
+					     ++b ) {
+						cumulative += h.buckets[first + b];
+					}
+				}
+				out.append( "jsonrpc_call_duration_seconds_bucket" );
+				labels( );
+				out.append( ",le=\"+Inf\"} " );
+				append_number( out, h.count );
+				out.append( "\njsonrpc_call_duration_seconds_sum" );
+				labels( );
+				out.append( "} " );
+				append_number( out, static_cast<double>( h.sum_ns ) * 1e-9 );
+				out.append( "\njsonrpc_call_duration_seconds_count" );
+				labels( );
+				out.append( "} " );
+				append_number( out, h.count );
+				out.push_back( '\n' );
+			}
+		}
+	}
+
+	bool should_sample( std::uint32_t sample_every ) {
+		thread_local std::uint32_t calls = 0;
+		return sample_every != 0 and ++calls % sample_every == 0;
+	}
+} // namespace daw::json_rpc::details
@@ -0,0 +1,104 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_rcu.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace daw::json_rpc::details {
+	inline namespace {
+		struct alignas( 64 ) reader_slot {
+			// The epoch the reader entered in, 0 when not reading
+			std::atomic<std::uint64_t> epoch = 0;
+			std::atomic<bool> in_use = false;
+		};
+
+		struct reader_registry {
+			std::mutex mutex{ };
+			// A deque so that slots never move
+			std::deque<reader_slot> slots{ };
+		};
+
+		// Leaked so that threads exiting after main returns can still release
+		// their slot
+		reader_registry &get_registry( ) {
+			static auto *registry = new reader_registry( );
+			return *registry;
+		}
+
+		std::atomic<std::uint64_t> global_epoch = 1;
+
+		reader_slot &acquire_slot( ) {
+			auto &registry = get_registry( );
+			auto lck = std::unique_lock( registry.mutex );
+			for( auto &slot : registry.slots ) {
+				if( not slot.in_use.load( std::memory_order_relaxed ) ) {
+					slot.in_use.store( true, std::memory_order_relaxed );
+					return slot;
+				}
+			}
+			auto &slot = registry.slots.emplace_back( );
+			slot.in_use.store( true, std::memory_order_relaxed );
+			return slot;
+		}
+
+		struct thread_reader {
+			reader_slot *slot = nullptr;
+			std::size_t depth = 0;
+
+			~thread_reader( ) {
+				if( slot ) {
+					auto lck = std::unique_lock( get_registry( ).mutex );
+					slot->in_use.store( false, std::memory_order_relaxed );
+				}
+			}
+		};
+
+		thread_local thread_reader this_reader{ };
+	} // namespace
+
+	rcu_read_guard::rcu_read_guard( ) {
+		auto &reader = this_reader;
+		if( reader.depth++ != 0 ) {
+			return;
+		}
+		if( not reader.slot ) {
+			reader.slot = &acquire_slot( );
+		}
+		reader.slot->epoch.store( global_epoch.load( ), std::memory_order_relaxed );
+		// Orders the announcement before the reads of the protected data, pairs
+		// with the fence in rcu_is_quiescent
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+	}
+
+	rcu_read_guard::~rcu_read_guard( ) {
+		auto &reader = this_reader;
+		if( --reader.depth == 0 ) {
+			reader.slot->epoch.store( 0, std::memory_order_release );
+		}
+	}
+
+	std::uint64_t rcu_advance( ) {
+		return global_epoch.fetch_add( 1 ) + 1;
+	}
+
+	bool rcu_is_quiescent( std::uint64_t epoch ) {
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		auto &registry = get_registry( );
+		auto lck = std::unique_lock( registry.mutex );
+		for( auto const &slot : registry.slots ) {
+			auto const e = slot.epoch.load( std::memory_order_acquire );
+			if( e != 0 and e < epoch ) {
+				return false;
+			}
+		}
+		return true;
+	}
+} // namespace daw::json_rpc::details
@@ -0,0 +1,164 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_result_cache.h"
+#include "daw/json_rpc/json_rpc_response_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace daw::json_rpc::details {
+	inline namespace {
+		using clock_t = std::chrono::steady_clock;
+
+		constexpr std::string_view result_prefix = R"({"jsonrpc":"2.0","result":)";
+		constexpr std::string_view id_prefix = R"(,"id":)";
+
+		struct key_hash {
+			using is_transparent = void;
+
+			std::size_t operator( )( std::string_view key ) const noexcept {
+				return std::hash<std::string_view>{ }( key );
+			}
+		};
+	} // namespace
+
+	struct result_cache::shard {
+		struct entry {
+			std::string key;
+			// The response up to, but not including, the id and closing brace
+			std::string response;
+			clock_t::time_point expires;
+		};
+
+		std::mutex mutex{ };
+		// Most recently used first
+		std::list<entry> lru{ };
+		std::unordered_map<std::string_view, std::list<entry>::iterator, key_hash,
+		                   std::equal_to<>>
+		  index{ };
+		std::size_t bytes = 0;
+		std::size_t max_bytes;
+
+		explicit shard( std::size_t MaxBytes )
+		  : max_bytes( MaxBytes ) {}
+
+		void erase( std::list<entry>::iterator it ) {
+			bytes -= it->key.size( ) + it->response.size( );
+			index.erase( it->key );
+			lru.erase( it );
+		}
+	};
+
+	result_cache::result_cache( cache_options const &opts )
+	  : m_ttl( opts.ttl ) {
+		auto const count = std::max<std::size_t>( opts.shards, 1 );
+		m_shards.reserve( count );
+		for( std::size_t n = 0; n < count; ++n ) {
+			m_shards.push_back( std::make_unique<shard>( opts.max_bytes / count ) );
+		}
+	}
+
+	result_cache::~result_cache( ) = default;
+
+	result_cache::shard &result_cache::get_shard( std::string_view key ) const {
+		return *m_shards[key_hash{ }( key ) % m_shards.size( )];
+	}
+
+	std::string result_cache::make_key( std::string_view params_json ) {
+		auto result = std::string( );
+		result.reserve( params_json.size( ) );
+		bool in_string = false;
+		bool is_escaped = false;
+		for( char c : params_json ) {
+			if( in_string ) {
+				if( is_escaped ) {
+					is_escaped = false;
+				} else if( c == '\\' ) {
+					is_escaped = true;
+				} else if( c == '"' ) {
+					in_string = false;
+				}
+			} else if( c == ' ' or c == '\t' or c == '\n' or c == '\r' ) {
+				continue;
+			} else if( c == '"' ) {
+				in_string = true;
+			}
+			result.push_back( c );
+		}
+		return result;
+	}
+
+	bool result_cache::try_write( std::string_view key, raw_id_type const &id,
+	                              std::string &buff ) {
+		auto &s = get_shard( key );
+		auto lck = std::unique_lock( s.mutex );
+		auto pos = s.index.find( key );
+		if( pos == s.index.end( ) ) {
+			lck.unlock( );
+			++m_misses;
+			return false;
+		}
+		auto it = pos->second;
+		if( it->expires <= clock_t::now( ) ) {
+			s.erase( it );
+			lck.unlock( );
+			++m_misses;
+			return false;
+		}
+		s.lru.splice( s.lru.begin( ), s.lru, it );
+		buff.append( it->response );
+		lck.unlock( );
+		write_id( buff, id );
+		buff.push_back( '}' );
+		++m_hits;
+		return true;
+	}
+
+	void result_cache::insert( std::string key, std::string_view response,
+	                           std::size_t id_size ) {
+		if( not response.starts_with( result_prefix ) or
+		    response.size( ) < result_prefix.size( ) + id_prefix.size( ) + id_size +
+		                         1 or
+		    not response.ends_with( '}' ) ) {
+			return;
+		}
+		response.remove_suffix( id_size + 1 );
+		if( not response.ends_with( id_prefix ) ) {
+			return;
+		}
+		auto &s = get_shard( key );
+		if( key.size( ) + response.size( ) > s.max_bytes ) {
+			return;
+		}
+		auto lck = std::unique_lock( s.mutex );
+		if( auto pos = s.index.find( key ); pos != s.index.end( ) ) {
+			s.erase( pos->second );
+		}
+		s.lru.push_front( { std::move( key ), std::string( response ),
+		                    clock_t::now( ) + m_ttl } );
+		auto const it = s.lru.begin( );
+		s.index.emplace( it->key, it );
+		s.bytes += it->key.size( ) + it->response.size( );
+		while( s.bytes > s.max_bytes ) {
+			s.erase( std::prev( s.lru.end( ) ) );
+		}
+	}
+
+	cache_stats result_cache::stats( ) const {
+		return { m_hits.load( ), m_misses.load( ) };
+	}
+} // namespace daw::json_rpc::details
@@ -0,0 +1,435 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_static_files.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace daw::json_rpc::details {
+	inline namespace {
+		bool is_base_of( std::filesystem::path const &base,
+		                 std::filesystem::path const &path ) {
+			return std::mismatch( base.begin( ), base.end( ), path.begin( ),
+			                      path.end( ) )
+			         .first == base.end( );
+		}
+
+		constexpr auto day_names = std::array<std::string_view, 7>{
+		  "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+
+		constexpr auto month_names = std::array<std::string_view, 12>{
+		  "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+		  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+		std::string_view trim( std::string_view str ) {
+			auto const first = str.find_first_not_of( " \t" );
+			if( first == std::string_view::npos ) {
+				return { };
+			}
+			auto const last = str.find_last_not_of( " \t" );
+			return str.substr( first, last - first + 1 );
+		}
+
+		// Splits off the text before the next comma, consuming the comma
+		std::string_view pop_list_item( std::string_view &list ) {
+			auto const pos = list.find( ',' );
+			auto const result = list.substr( 0, pos );
+			list.remove_prefix( pos == std::string_view::npos ? list.size( )
+			                                                  : pos + 1 );
+			return trim( result );
+		}
+
+		constexpr char to_lower( char c ) {
+			return c >= 'A' and c <= 'Z' ? static_cast<char>( c - 'A' + 'a' ) : c;
+		}
+
+		bool iequals( std::string_view lhs, std::string_view rhs ) {
+			return lhs.size( ) == rhs.size( ) and
+			       std::equal( lhs.begin( ), lhs.end( ), rhs.begin( ),
+			                   []( char l, char r ) {
+				                   return to_lower( l ) == to_lower( r );
+			                   } );
+		}
+
+		template<typename Number>
+		bool parse_number( std::string_view str, Number &n ) {
+			if( str.empty( ) ) {
+				return false;
+			}
+			auto const r =
+			  std::from_chars( str.data( ), str.data( ) + str.size( ), n );
+			return r.ec == std::errc{ } and r.ptr == str.data( ) + str.size( );
+		}
+
+		// Quality values have at most three decimals, so only all zeros is q=0
+		bool is_zero_quality( std::string_view params ) {
+			while( not params.empty( ) ) {
+				auto const pos = params.find( ';' );
+				auto param = trim( params.substr( 0, pos ) );
+				params.remove_prefix( pos == std::string_view::npos ? params.size( )
+				                                                    : pos + 1 );
+				if( param.size( ) < 2 or to_lower( param[0] ) != 'q' or
+				    param[1] != '=' ) {
+					continue;
+				}
+				param.remove_prefix( 2 );
+				return param.find_first_not_of( "0." ) == std::string_view::npos;
+			}
+			return false;
+		}
+
+		std::string make_etag( std::uint64_t size,
+		                       std::filesystem::file_time_type mtime ) {
+			char buff[48];
+			auto *ptr = buff;
+			*ptr++ = '"';
+			ptr = std::to_chars( ptr, buff + sizeof( buff ), size, 16 ).ptr;
+			*ptr++ = '-';
+			ptr = std::to_chars(
+			        ptr, buff + sizeof( buff ),
+			        static_cast<std::uint64_t>( mtime.time_since_epoch( ).count( ) ),
+			        16 )
+			        .ptr;
+			*ptr++ = '"';
+			return std::string( buff, ptr );
+		}
+
+		std::shared_ptr<static_file> load_file( std::filesystem::path const &path,
+		                                        std::size_t max_memory_file_size ) {
+			auto result = std::make_shared<static_file>( );
+			result->path = path;
+			auto ec = std::error_code( );
+			result->mtime = std::filesystem::last_write_time( path, ec );
+			if( ec ) {
+				return { };
+			}
+			result->size = std::filesystem::file_size( path, ec );
+			if( ec ) {
+				return { };
+			}
+			if( result->size <= max_memory_file_size ) {
+				auto in = std::ifstream( path, std::ios::binary );
+				auto contents = std::string( );
+				contents.resize( static_cast<std::size_t>( result->size ) );
+				if( not in.read( contents.data( ),
+				                 static_cast<std::streamsize>( contents.size( ) ) ) ) {
+					return { };
+				}
+				result->contents =
+				  std::make_shared<std::string const>( std::move( contents ) );
+			}
+			result->etag = make_etag( result->size, result->mtime );
+			result->modified = std::chrono::floor<std::chrono::seconds>(
+			  std::chrono::file_clock::to_sys( result->mtime ) );
+			result->last_modified = format_http_date( result->modified );
+			return result;
+		}
+
+		std::filesystem::path sibling( std::filesystem::path p,
+		                               char const *extension ) {
+			p += extension;
+			return p;
+		}
+
+		// A precompressed sibling older than the file was left behind by an
+		// earlier build and is not served
+		std::shared_ptr<static_file const>
+		load_variant( static_file const &file, char const *extension,
+		              std::size_t max_memory_file_size ) {
+			auto const path = sibling( file.path, extension );
+			auto ec = std::error_code( );
+			if( not std::filesystem::is_regular_file( path, ec ) ) {
+				return { };
+			}
+			auto result = load_file( path, max_memory_file_size );
+			if( not result or result->mtime < file.mtime ) {
+				return { };
+			}
+			return result;
+		}
+
+		bool is_unchanged( static_file const &file ) {
+			auto ec = std::error_code( );
+			auto const mtime = std::filesystem::last_write_time( file.path, ec );
+			if( ec or mtime != file.mtime ) {
+				return false;
+			}
+			auto const size = std::filesystem::file_size( file.path, ec );
+			return not ec and size == file.size;
+		}
+
+		// Precompressed siblings are rarely added or removed on their own, but
+		// a missed one would be served stale until the file changed
+		bool
+		is_variant_unchanged( static_file const &file,
+		                      std::shared_ptr<static_file const> const &variant,
+		                      char const *extension ) {
+			if( variant ) {
+				return is_unchanged( *variant );
+			}
+			auto ec = std::error_code( );
+			return not std::filesystem::exists( sibling( file.path, extension ),
+			                                     ec );
+		}
+	} // namespace
+
+	static_file_cache::static_file_cache( std::filesystem::path const &base,
+	                                      std::optional<std::string> default_file,
+	                                      static_file_options opts )
+	  : m_base( std::filesystem::canonical( base ) )
+	  , m_default_file( std::move( default_file ) )
+	  , m_options( opts ) {}
+
+	std::shared_ptr<static_file const>
+	static_file_cache::load( std::filesystem::path const &path ) const {
+		auto result = load_file( path, m_options.max_memory_file_size );
+		if( result ) {
+			result->gzip =
+			  load_variant( *result, ".gz", m_options.max_memory_file_size );
+			result->brotli =
+			  load_variant( *result, ".br", m_options.max_memory_file_size );
+		}
+		return result;
+	}
+
+	// Symbolic links are followed, but only to files below the base directory
+	std::shared_ptr<static_file const>
+	static_file_cache::resolve( std::string const &rel_path ) const {
+		auto ec = std::error_code( );
+		auto const path = std::filesystem::canonical( m_base / rel_path, ec );
+		if( ec or not is_base_of( m_base, path ) ) {
+			return { };
+		}
+		auto const status = std::filesystem::status( path, ec );
+		if( std::filesystem::is_regular_file( status ) ) {
+			return load( path );
+		}
+		if( not m_default_file or not std::filesystem::is_directory( status ) ) {
+			return { };
+		}
+		auto const file = std::filesystem::canonical( path / *m_default_file, ec );
+		if( ec or not is_base_of( m_base, file ) or
+		    not std::filesystem::is_regular_file( file, ec ) ) {
+			return { };
+		}
+		return load( file );
+	}
+
+	std::shared_ptr<static_file const>
+	static_file_cache::find( std::string const &rel_path ) {
+		auto const now = clock_t::now( );
+		auto current = entry{ };
+		bool is_cached = false;
+		{
+			auto lck = std::unique_lock( m_mutex );
+			if( auto pos = m_entries.find( rel_path ); pos != m_entries.end( ) ) {
+				current = pos->second;
+				is_cached = true;
+			}
+		}
+		if( is_cached and now - current.checked < m_options.revalidate_interval ) {
+			return current.file;
+		}
+		// The filesystem is checked without holding the lock
+		auto file = current.file;
+		if( not file or not is_unchanged( *file ) or
+		    not is_variant_unchanged( *file, file->gzip, ".gz" ) or
+		    not is_variant_unchanged( *file, file->brotli, ".br" ) ) {
+			file = resolve( rel_path );
+		}
+		auto lck = std::unique_lock( m_mutex );
+		if( m_entries.size( ) >= m_options.max_entries and
+		    not m_entries.contains( rel_path ) ) {
+			// Most requests are for a small set of paths, which are resolved again
+			// as they are requested
+			m_entries.clear( );
+		}
+		m_entries.insert_or_assign( rel_path, entry{ file, now } );
+		return file;
+	}
+
+	std::string format_http_date( std::chrono::system_clock::time_point tp ) {
+		using namespace std::chrono;
+		auto const day = floor<days>( tp );
+		auto const ymd = year_month_day( day );
+		auto const tod = hh_mm_ss( floor<seconds>( tp - day ) );
+		auto const wd = weekday( day );
+		char buff[32];
+		auto *ptr = buff;
+		auto const append = [&]( std::string_view str ) {
+			ptr = std::copy( str.begin( ), str.end( ), ptr );
+		};
+		auto const append_padded = [&]( unsigned n, int width ) {
+			char num[8];
+			auto const r = std::to_chars( num, num + sizeof( num ), n );
+			ptr = std::fill_n( ptr, width - ( r.ptr - num ), '0' );
+			ptr = std::copy( num, r.ptr, ptr );
+		};
+		append( day_names[wd.c_encoding( )] );
+		append( ", " );
+		append_padded( unsigned( ymd.day( ) ), 2 );
+		*ptr++ = ' ';
+		append( month_names[unsigned( ymd.month( ) ) - 1] );
+		*ptr++ = ' ';
+		append_padded( static_cast<unsigned>( int( ymd.year( ) ) ), 4 );
+		*ptr++ = ' ';
+		append_padded( static_cast<unsigned>( tod.hours( ).count( ) ), 2 );
+		*ptr++ = ':';
+		append_padded( static_cast<unsigned>( tod.minutes( ).count( ) ), 2 );
+		*ptr++ = ':';
+		append_padded( static_cast<unsigned>( tod.seconds( ).count( ) ), 2 );
+		append( " GMT" );
+		return std::string( buff, ptr );
+	}
+
+	std::optional<std::chrono::system_clock::time_point>
+	parse_http_date( std::string_view date ) {
+		using namespace std::chrono;
+		// Sun, 06 Nov 1994 08:49:37 GMT
+		date = trim( date );
+		if( date.size( ) != 29 or date.substr( 3, 2 ) != ", " or
+		    date.substr( 25 ) != " GMT" or date[7] != ' ' or date[11] != ' ' or
+		    date[16] != ' ' or date[19] != ':' or date[22] != ':' ) {
+			return std::nullopt;
+		}
+		auto const month_pos = std::find( month_names.begin( ), month_names.end( ),
+		                                  date.substr( 8, 3 ) );
+		unsigned d = 0;
+		int y = 0;
+		unsigned h = 0;
+		unsigned m = 0;
+		unsigned s = 0;
+		if( month_pos == month_names.end( ) or
+		    not parse_number( date.substr( 5, 2 ), d ) or
+		    not parse_number( date.substr( 12, 4 ), y ) or
+		    not parse_number( date.substr( 17, 2 ), h ) or
+		    not parse_number( date.substr( 20, 2 ), m ) or
+		    not parse_number( date.substr( 23, 2 ), s ) or h > 23 or m > 59 or
+		    s > 60 ) {
+			return std::nullopt;
+		}
+		auto const ymd = year( y ) /
+		                 month( static_cast<unsigned>(
+		                   month_pos - month_names.begin( ) + 1 ) ) /
+		                 day( d );
+		if( not ymd.ok( ) ) {
+			return std::nullopt;
+		}
+		return sys_days( ymd ) + hours( h ) + minutes( m ) + seconds( s );
+	}
+
+	bool etag_matches( std::string_view if_none_match, std::string_view etag ) {
+		auto const opaque = []( std::string_view tag ) {
+			if( tag.starts_with( "W/" ) ) {
+				tag.remove_prefix( 2 );
+			}
+			return tag;
+		};
+		while( not if_none_match.empty( ) ) {
+			auto const tag = pop_list_item( if_none_match );
+			if( tag == "*" or
+			    ( not tag.empty( ) and opaque( tag ) == opaque( etag ) ) ) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool accepts_encoding( std::string_view accept_encoding,
+	                       std::string_view coding ) {
+		bool wildcard = false;
+		while( not accept_encoding.empty( ) ) {
+			auto const item = pop_list_item( accept_encoding );
+			auto const pos = item.find( ';' );
+			auto const name = trim( item.substr( 0, pos ) );
+			auto const params = pos == std::string_view::npos
+			                      ? std::string_view( )
+			                      : item.substr( pos + 1 );
+			if( iequals( name, coding ) ) {
+				return not is_zero_quality( params );
+			}
+			if( name == "*" ) {
+				wildcard = not is_zero_quality( params );
+			}
+		}
+		return wildcard;
+	}
+
+	byte_range parse_range( std::string_view range, std::uint64_t size ) {
+		using status_t = byte_range::status_t;
+		range = trim( range );
+		if( range.size( ) < 6 or not iequals( range.substr( 0, 6 ), "bytes=" ) ) {
+			return { };
+		}
+		range.remove_prefix( 6 );
+		auto const spec = pop_list_item( range );
+		auto const dash = spec.find( '-' );
+		if( not range.empty( ) or dash == std::string_view::npos ) {
+			return { };
+		}
+		auto const first_str = trim( spec.substr( 0, dash ) );
+		auto const last_str = trim( spec.substr( dash + 1 ) );
+		auto result = byte_range{ status_t::partial };
+		if( first_str.empty( ) ) {
+			// A suffix range, the last n bytes
+			auto n = std::uint64_t{ };
+			if( not parse_number( last_str, n ) ) {
+				return { };
+			}
+			if( n == 0 or size == 0 ) {
+				return byte_range{ status_t::unsatisfiable };
+			}
+			result.first = size - std::min( n, size );
+			result.last = size - 1;
+			return result;
+		}
+		if( not parse_number( first_str, result.first ) ) {
+			return { };
+		}
+		result.last = size;
+		if( not last_str.empty( ) ) {
+			if( not parse_number( last_str, result.last ) ) {
+				return { };
+			}
+			if( result.last < result.first ) {
+				return { };
+			}
+		}
+		if( result.first >= size ) {
+			return byte_range{ status_t::unsatisfiable };
+		}
+		result.last = std::min( result.last, size - 1 );
+		return result;
+	}
+
+	std::string read_file_range( std::filesystem::path const &path,
+	                             std::uint64_t offset, std::uint64_t count ) {
+		auto in = std::ifstream( path, std::ios::binary );
+		auto result = std::string( );
+		result.resize( static_cast<std::size_t>( count ) );
+		if( not in.seekg( static_cast<std::streamoff>( offset ) ) or
+		    not in.read( result.data( ),
+		                 static_cast<std::streamsize>( result.size( ) ) ) ) {
+			throw std::system_error( std::make_error_code( std::errc::io_error ),
+			                         "Unable to read " + path.string( ) );
+		}
+		return result;
+	}
+} // namespace daw::json_rpc::details
@@ -0,0 +1,178 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace daw::json_rpc {
+	inline namespace {
+		struct current_worker_t {
+			thread_pool const *pool = nullptr;
+			std::size_t index = 0;
+		};
+
+		thread_local current_worker_t current_worker{ };
+
+		// The lane a worker tries first on each turn.  Over eight turns the high
+		// lane is tried first four times, the normal lane three times and the low
+		// lane once, so a saturated lane cannot starve the lanes below it
+		constexpr std::array<std::size_t, 8> lane_schedule = { 0, 1, 0, 1,
+		                                                       0, 1, 0, 2 };
+	} // namespace
+
+	thread_pool::thread_pool( std::size_t thread_count, std::size_t max_queued )
+	  : m_max_queued( max_queued ) {
+		thread_count = std::max<std::size_t>( thread_count, 1 );
+		m_queues.reserve( thread_count );
+		for( std::size_t n = 0; n < thread_count; ++n ) {
+			m_queues.push_back( std::make_unique<worker_queue>( ) );
+		}
+		m_threads.reserve( thread_count );
+		for( std::size_t n = 0; n < thread_count; ++n ) {
+			m_threads.emplace_back( [this, n] {
+				worker( n );
+			} );
+		}
+	}
+
+	thread_pool::~thread_pool( ) {
+		{
+			auto lck = std::unique_lock( m_sleep_mutex );
+			m_stopping = true;
+		}
+		m_cv.notify_all( );
+		for( auto &t : m_threads ) {
+			t.join( );
+		}
+	}
+
+	// A worker takes the newest task from its own queue, as it is the most
+	// likely to still be in cache, and steals the oldest task from the others
+	bool thread_pool::try_pop( std::size_t index, std::size_t lane,
+	                           std::function<void( )> &task ) {
+		if( m_lanes[lane].queued == 0 ) {
+			return false;
+		}
+		bool found = false;
+		{
+			auto &tasks = m_queues[index]->lanes[lane];
+			auto lck = std::unique_lock( m_queues[index]->mutex );
+			if( not tasks.empty( ) ) {
+				task = std::move( tasks.back( ) );
+				tasks.pop_back( );
+				found = true;
+			}
+		}
+		for( std::size_t n = 1; n < m_queues.size( ) and not found; ++n ) {
+			auto &q = *m_queues[( index + n ) % m_queues.size( )];
+			auto lck = std::unique_lock( q.mutex );
+			if( not q.lanes[lane].empty( ) ) {
+				task = std::move( q.lanes[lane].front( ) );
+				q.lanes[lane].pop_front( );
+				found = true;
+			}
+		}
+		if( found ) {
+			--m_lanes[lane].queued;
+		}
+		return found;
+	}
+
+	bool thread_pool::try_pop( std::size_t index, std::size_t turn,
+	                           std::function<void( )> &task, std::size_t &lane ) {
+		auto const first = lane_schedule[turn % lane_schedule.size( )];
+		if( try_pop( index, first, task ) ) {
+			lane = first;
+			return true;
+		}
+		for( std::size_t l = 0; l < priority_count; ++l ) {
+			if( l != first and try_pop( index, l, task ) ) {
+				lane = l;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void thread_pool::worker( std::size_t index ) {
+		current_worker = { this, index };
+		auto task = std::function<void( )>{ };
+		std::size_t turn = 0;
+		std::size_t lane = 0;
+		while( true ) {
+			if( try_pop( index, turn++, task, lane ) ) {
+				--m_queued;
+				task( );
+				task = nullptr;
+				++m_lanes[lane].completed;
+				continue;
+			}
+			auto lck = std::unique_lock( m_sleep_mutex );
+			m_cv.wait( lck, [&] {
+				return m_stopping or m_queued > 0;
+			} );
+			if( m_stopping and m_queued == 0 ) {
+				return;
+			}
+		}
+	}
+
+	void thread_pool::push( std::function<void( )> task, priority lane ) {
+		auto const index = current_worker.pool == this
+		                     ? current_worker.index
+		                     : m_next_queue++ % m_queues.size( );
+		{
+			auto &q = *m_queues[index];
+			auto lck = std::unique_lock( q.mutex );
+			q.lanes[static_cast<std::size_t>( lane )].push_back( std::move( task ) );
+		}
+		// Taking the lock orders this with a worker that has checked m_queued
+		// but not yet started waiting, so the notification cannot be lost
+		{
+			auto lck = std::unique_lock( m_sleep_mutex );
+		}
+		m_cv.notify_one( );
+	}
+
+	void thread_pool::submit( std::function<void( )> task, priority lane ) {
+		++m_lanes[static_cast<std::size_t>( lane )].queued;
+		++m_queued;
+		push( std::move( task ), lane );
+	}
+
+	bool thread_pool::try_submit( std::function<void( )> task, priority lane ) {
+		auto &counters = m_lanes[static_cast<std::size_t>( lane )];
+		if( counters.queued++ >= m_max_queued ) {
+			--counters.queued;
+			++counters.rejected;
+			return false;
+		}
+		++m_queued;
+		push( std::move( task ), lane );
+		return true;
+	}
+
+	std::size_t thread_pool::size( ) const {
+		return m_threads.size( );
+	}
+
+	std::size_t thread_pool::queued( ) const {
+		return m_queued;
+	}
+
+	lane_stats thread_pool::stats( priority lane ) const {
+		auto const &counters = m_lanes[static_cast<std::size_t>( lane )];
+		return { counters.queued, counters.completed, counters.rejected };
+	}
+} // namespace daw::json_rpc
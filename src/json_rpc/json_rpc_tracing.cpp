@@ -0,0 +1,134 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "daw/json_rpc/json_rpc_tracing.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace daw::json_rpc {
+	inline namespace {
+		// version-trace_id-parent_id-flags
+		constexpr std::size_t traceparent_size = 2 + 1 + 32 + 1 + 16 + 1 + 2;
+
+		constexpr char hex_digits[] = "0123456789abcdef";
+
+		constexpr int hex_value( char c ) {
+			if( c >= '0' and c <= '9' ) {
+				return c - '0';
+			}
+			// Only lower case is allowed
+			if( c >= 'a' and c <= 'f' ) {
+				return c - 'a' + 10;
+			}
+			return -1;
+		}
+
+		template<std::size_t N>
+		bool parse_hex( std::string_view str, std::array<std::uint8_t, N> &out ) {
+			for( std::size_t n = 0; n < N; ++n ) {
+				auto const hi = hex_value( str[n * 2] );
+				auto const lo = hex_value( str[n * 2 + 1] );
+				if( hi < 0 or lo < 0 ) {
+					return false;
+				}
+				out[n] = static_cast<std::uint8_t>( ( hi << 4 ) | lo );
+			}
+			return true;
+		}
+
+		template<std::size_t N>
+		void append_hex( std::string &out, std::array<std::uint8_t, N> const &in ) {
+			for( auto b : in ) {
+				out.push_back( hex_digits[b >> 4] );
+				out.push_back( hex_digits[b & 0xF] );
+			}
+		}
+
+		template<std::size_t N>
+		bool is_zero( std::array<std::uint8_t, N> const &a ) {
+			return std::all_of( a.begin( ), a.end( ),
+			                    []( std::uint8_t b ) { return b == 0; } );
+		}
+
+		// Ids only need to be unlikely to collide, not unpredictable
+		template<std::size_t N>
+		std::array<std::uint8_t, N> random_id( ) {
+			thread_local auto engine = std::mt19937_64( std::random_device{ }( ) );
+			auto result = std::array<std::uint8_t, N>{ };
+			do {
+				for( std::size_t n = 0; n < N; n += 8 ) {
+					auto v = engine( );
+					for( std::size_t b = n; b < std::min( N, n + 8 ); ++b ) {
+						result[b] = static_cast<std::uint8_t>( v );
+						v >>= 8;
+					}
+				}
+			} while( is_zero( result ) );
+			return result;
+		}
+	} // namespace
+
+	tracer::~tracer( ) = default;
+
+	bool trace_context::is_valid( ) const {
+		return not is_zero( trace_id );
+	}
+
+	std::optional<trace_context> parse_traceparent( std::string_view value ) {
+		if( value.size( ) != traceparent_size or not value.starts_with( "00-" ) or
+		    value[35] != '-' or value[52] != '-' ) {
+			return std::nullopt;
+		}
+		auto result = trace_context{ };
+		auto flags = std::array<std::uint8_t, 1>{ };
+		if( not parse_hex( value.substr( 3, 32 ), result.trace_id ) or
+		    not parse_hex( value.substr( 36, 16 ), result.span_id ) or
+		    not parse_hex( value.substr( 53, 2 ), flags ) ) {
+			return std::nullopt;
+		}
+		if( is_zero( result.trace_id ) or is_zero( result.span_id ) ) {
+			return std::nullopt;
+		}
+		result.flags = flags[0];
+		return result;
+	}
+
+	std::string to_traceparent( trace_context const &ctx ) {
+		auto result = std::string( );
+		result.reserve( traceparent_size );
+		result.append( "00-" );
+		append_hex( result, ctx.trace_id );
+		result.push_back( '-' );
+		append_hex( result, ctx.span_id );
+		result.push_back( '-' );
+		append_hex( result, std::array<std::uint8_t, 1>{ ctx.flags } );
+		return result;
+	}
+
+	std::optional<trace_context> this_request::trace( ) {
+		auto const &state = details::current_trace;
+		if( not state.sink ) {
+			return std::nullopt;
+		}
+		return state.context;
+	}
+
+	trace_context details::new_trace( ) {
+		// Traces begun here are sampled, as a tracer was installed to see them
+		return trace_context{ random_id<16>( ), { }, 0x01 };
+	}
+
+	span_id_type details::new_span_id( ) {
+		return random_id<8>( );
+	}
+} // namespace daw::json_rpc
@@ -9,25 +9,346 @@
 
 #include "daw/json_rpc_server.h"
 #include "daw/daw_storage_ref.h"
+#include "daw/json_rpc/json_rpc_buffer_pool.h"
+#include "daw/json_rpc/json_rpc_compression.h"
 #include "daw/json_rpc/json_rpc_dispatch.h"
 #include "daw/json_rpc/json_rpc_request_json.h"
+#include "daw/json_rpc/json_rpc_response_writer.h"
 #include "daw/json_rpc/json_rpc_server_request.h"
+#include "daw/json_rpc/json_rpc_static_files.h"
 
 #include <daw/daw_construct_at.h>
-#include <daw/daw_memory_mapped_file.h>
 #include <daw/daw_string_view.h>
 #include <daw/json/daw_json_link.h>
 #include <daw/daw_move.h>
 
 #include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
 #include <crow.h>
 #include <crow/middlewares/cookie_parser.h>
 #include <filesystem>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 
 namespace daw::json_rpc {
+	inline namespace {
+		// Shared between a WebSocket connection and the requests in flight on it.
+		// Crow destroys the connection after on_close, so responses completing
+		// afterwards are dropped
+		class ws_session {
+			std::mutex m_mutex{ };
+			crow::websocket::connection *m_conn;
+
+		public:
+			explicit ws_session( crow::websocket::connection &conn )
+			  : m_conn( &conn ) {}
+
+			void send( std::string msg ) {
+				auto lck = std::unique_lock( m_mutex );
+				if( m_conn ) {
+					m_conn->send_text( std::move( msg ) );
+				}
+			}
+
+			void close( ) {
+				auto lck = std::unique_lock( m_mutex );
+				m_conn = nullptr;
+			}
+		};
+
+		using ws_session_ptr = std::shared_ptr<ws_session>;
+
+		// The response to a request turned away by admission control
+		std::string server_busy_response( ) {
+			auto resp = std::string( );
+			details::write_error_response( resp, Error( -32000, "Server busy" ),
+			                               details::raw_id_type{ } );
+			return resp;
+		}
+
+		// Streamed results are sent as a frame per part.  The ticket is held
+		// until the response is ready
+		template<typename Send>
+		void process_ws_message( json_rpc_dispatch const &dispatcher,
+		                         std::string const &msg, Send send,
+		                         details::admission_ticket ticket ) {
+			auto const stream = details::stream_sink_scope(
+			  std::make_shared<details::stream_sink const>( send ) );
+			auto resp = std::string( );
+			try {
+				auto result = dispatcher.process( msg, resp );
+				if( result.deferred ) {
+					result.deferred.on_ready(
+					  [send = std::move( send ),
+					   ticket = std::make_shared<details::admission_ticket>(
+					     std::move( ticket ) )]( std::string r ) mutable {
+						  ticket.reset( );
+						  if( not r.empty( ) ) {
+							  send( std::move( r ) );
+						  }
+					  } );
+					return;
+				}
+			} catch( ... ) {
+				resp.clear( );
+				auto it = std::back_inserter( resp );
+				(void)daw::json::to_json(
+				  json_rpc_response_error( Error( -32603, "Error handling request" ) ),
+				  it );
+			}
+			if( not resp.empty( ) ) {
+				send( std::move( resp ) );
+			}
+		}
+
+		// The deadline set by the request_timeout_header, if present and valid
+		deadline_type request_deadline( crow::request const &req ) {
+			auto const &value = req.get_header_value( request_timeout_header );
+			auto ms = std::int64_t{ };
+			auto const [ptr, ec] =
+			  std::from_chars( value.data( ), value.data( ) + value.size( ), ms );
+			if( value.empty( ) or ec != std::errc{ } ) {
+				return { };
+			}
+			return details::deadline_after( deadline_clock::now( ), ms );
+		}
+
+		// The trace a request continues.  The header is only read when the
+		// server traces requests
+		std::optional<trace_context>
+		request_trace_parent( tracer const *sink, crow::request const &req ) {
+			if constexpr( details::tracing_enabled ) {
+				if( sink ) {
+					return parse_traceparent(
+					  req.get_header_value( traceparent_header ) );
+				}
+			}
+			return std::nullopt;
+		}
+
+		// Held by a deferred response until it is ready
+		struct deferred_request {
+			details::admission_ticket ticket;
+			details::detached_span span;
+		};
+
+		std::string content_type( std::string_view path ) {
+			auto const name = path.substr( path.find_last_of( "/\\" ) + 1 );
+			auto const dot = name.find_last_of( '.' );
+			auto const ext = dot == std::string_view::npos
+			                   ? std::string( )
+			                   : std::string( name.substr( dot + 1 ) );
+			if( auto pos = crow::mime_types.find( ext );
+			    pos != crow::mime_types.end( ) ) {
+				return pos->second;
+			}
+			return "text/plain";
+		}
+
+		// Conditional requests are evaluated against the representation that
+		// would be sent, as caches store each encoding separately
+		bool is_not_modified( crow::request const &req,
+		                      details::static_file const &file ) {
+			auto const &if_none_match = req.get_header_value( "If-None-Match" );
+			if( not if_none_match.empty( ) ) {
+				return details::etag_matches( if_none_match, file.etag );
+			}
+			auto const &if_modified_since =
+			  req.get_header_value( "If-Modified-Since" );
+			if( if_modified_since.empty( ) ) {
+				return false;
+			}
+			auto const since = details::parse_http_date( if_modified_since );
+			return since and file.modified <= *since;
+		}
+
+		// A range is only sent when the client's copy, named by If-Range, is
+		// still current.  Otherwise the whole file is sent
+		bool is_range_current( crow::request const &req,
+		                       details::static_file const &file ) {
+			auto const &if_range = req.get_header_value( "If-Range" );
+			if( if_range.empty( ) ) {
+				return true;
+			}
+			if( if_range.starts_with( '"' ) ) {
+				return if_range == file.etag;
+			}
+			return if_range == file.last_modified;
+		}
+
+		details::static_file const &
+		select_encoding( crow::request const &req,
+		                 details::static_file const &file ) {
+			if( not file.brotli and not file.gzip ) {
+				return file;
+			}
+			auto const &accept_encoding = req.get_header_value( "Accept-Encoding" );
+			if( file.brotli and
+			    details::accepts_encoding( accept_encoding, "br" ) ) {
+				return *file.brotli;
+			}
+			if( file.gzip and
+			    details::accepts_encoding( accept_encoding, "gzip" ) ) {
+				return *file.gzip;
+			}
+			return file;
+		}
+
+		// Small files are served from memory.  Crow streams larger files from
+		// disk in small blocks, so they are never held in memory whole.
+		// Ranges are of the unencoded file
+		void send_file( crow::request const &req, crow::response &res,
+		                details::static_file const &file,
+		                static_file_options const &opts ) {
+			auto const &range_header = req.get_header_value( "Range" );
+			bool const is_range =
+			  not range_header.empty( ) and is_range_current( req, file );
+			auto const &rep = is_range ? file : select_encoding( req, file );
+			res.set_header( "ETag", rep.etag );
+			res.set_header( "Last-Modified", rep.last_modified );
+			res.set_header( "Accept-Ranges", "bytes" );
+			if( file.brotli or file.gzip ) {
+				res.set_header( "Vary", "Accept-Encoding" );
+			}
+			if( is_not_modified( req, rep ) ) {
+				res.code = 304;
+				return;
+			}
+			auto const range = is_range ? details::parse_range( range_header,
+			                                                    file.size )
+			                            : details::byte_range{ };
+			using status_t = details::byte_range::status_t;
+			if( range.status == status_t::unsatisfiable ) {
+				res.code = 416;
+				res.set_header( "Content-Range",
+				                "bytes */" + std::to_string( file.size ) );
+				return;
+			}
+			if( range.status == status_t::partial ) {
+				auto const size =
+				  std::min<std::uint64_t>( range.size( ), opts.max_range_size );
+				if( file.contents ) {
+					res.body = file.contents->substr(
+					  static_cast<std::size_t>( range.first ),
+					  static_cast<std::size_t>( size ) );
+				} else {
+					res.body = details::read_file_range( file.path, range.first, size );
+				}
+				res.code = 206;
+				res.set_header( "Content-Range",
+				                "bytes " + std::to_string( range.first ) + '-' +
+				                  std::to_string( range.first + size - 1 ) + '/' +
+				                  std::to_string( file.size ) );
+			} else if( rep.contents ) {
+				res.body = *rep.contents;
+			} else {
+				res.set_static_file_info_unsafe( rep.path.string( ) );
+			}
+			// Replaces the type Crow derives from the extension of a
+			// precompressed sibling
+			res.set_header( "Content-Type", content_type( file.path.string( ) ) );
+			if( &rep == file.gzip.get( ) ) {
+				res.set_header( "Content-Encoding", "gzip" );
+			} else if( &rep == file.brotli.get( ) ) {
+				res.set_header( "Content-Encoding", "br" );
+			}
+		}
+
+		// Embedded files have no modification time, so are validated by their
+		// ETag alone
+		void send_embedded( crow::request const &req, crow::response &res,
+		                    embedded_file const &file ) {
+			auto const &range_header = req.get_header_value( "Range" );
+			auto const &if_range = req.get_header_value( "If-Range" );
+			bool const is_range = not range_header.empty( ) and
+			                      ( if_range.empty( ) or if_range == file.etag );
+			bool const is_gzip =
+			  not is_range and not file.gzip.empty( ) and
+			  details::accepts_encoding( req.get_header_value( "Accept-Encoding" ),
+			                             "gzip" );
+			auto const etag = is_gzip ? file.gzip_etag : file.etag;
+			auto const contents = is_gzip ? file.gzip : file.contents;
+			res.set_header( "ETag", std::string( etag ) );
+			res.set_header( "Accept-Ranges", "bytes" );
+			if( not file.gzip.empty( ) ) {
+				res.set_header( "Vary", "Accept-Encoding" );
+			}
+			if( auto const &if_none_match = req.get_header_value( "If-None-Match" );
+			    not if_none_match.empty( ) and
+			    details::etag_matches( if_none_match, etag ) ) {
+				res.code = 304;
+				return;
+			}
+			auto const range = is_range ? details::parse_range( range_header,
+			                                                    contents.size( ) )
+			                            : details::byte_range{ };
+			using status_t = details::byte_range::status_t;
+			switch( range.status ) {
+			case status_t::unsatisfiable:
+				res.code = 416;
+				res.set_header( "Content-Range",
+				                "bytes */" + std::to_string( contents.size( ) ) );
+				return;
+			case status_t::partial:
+				res.code = 206;
+				res.body = contents.substr( static_cast<std::size_t>( range.first ),
+				                            static_cast<std::size_t>( range.size( ) ) );
+				res.set_header( "Content-Range",
+				                "bytes " + std::to_string( range.first ) + '-' +
+				                  std::to_string( range.last ) + '/' +
+				                  std::to_string( contents.size( ) ) );
+				break;
+			case status_t::full:
+				res.body = contents;
+				break;
+			}
+			res.set_header( "Content-Type", content_type( file.path ) );
+			if( is_gzip ) {
+				res.set_header( "Content-Encoding", "gzip" );
+			}
+		}
+
+		// The compressed body is written to a pooled buffer, and the buffer
+		// of the uncompressed body returned to the pool in its place
+		void compress_body( crow::response &res, details::content_coding coding,
+		                    std::optional<compression_options> const &opts ) {
+			if( not opts ) {
+				return;
+			}
+			res.set_header( "Vary", "Accept-Encoding" );
+			if( coding == details::content_coding::identity or
+			    res.body.size( ) < opts->min_size ) {
+				return;
+			}
+			auto out = details::acquire_buffer( );
+			if( not details::compress( coding, opts->level, res.body, out ) or
+			    out.size( ) >= res.body.size( ) ) {
+				details::release_buffer( std::move( out ) );
+				return;
+			}
+			std::swap( res.body, out );
+			details::release_buffer( std::move( out ) );
+			res.set_header( "Content-Encoding", details::coding_name( coding ) );
+		}
+
+		void finish_response( crow::response &res, std::string body,
+		                      details::content_coding coding,
+		                      std::optional<compression_options> const &opts ) {
+			res.body = std::move( body );
+			if( not res.body.empty( ) ) {
+				res.add_header( "Content-Type", "application/json" );
+			}
+			compress_body( res, coding, opts );
+			res.end( );
+		}
+	} // namespace
+
 	json_rpc_server::json_rpc_server( ) {
 #if defined( NDEBUG )
 		server.loglevel( crow::LogLevel::Warning );
@@ -61,59 +382,216 @@ namespace daw::json_rpc {
 	json_rpc_server &
 	json_rpc_server::route_path_to( daw::string_view req_path,
 	                                json_rpc_dispatch &dispatcher ) & {
+		return route_json_rpc( req_path,
+		                       [&dispatcher]( daw::string_view json_doc,
+		                                      std::string &buff,
+		                                      deadline_type deadline ) {
+			                       return dispatcher.process( json_doc, buff,
+			                                                  deadline );
+		                       } );
+	}
+
+	json_rpc_server &
+	json_rpc_server::route_metrics( daw::string_view req_path,
+	                                json_rpc_dispatch const &dispatcher ) & {
+		server.route_dynamic( static_cast<std::string>( req_path ) )
+		  .methods( crow::HTTPMethod::GET )(
+		    [&dispatcher]( crow::request const &, crow::response &res ) {
+			    dispatcher.write_metrics( res.body );
+			    res.add_header( "Content-Type", "text/plain; version=0.0.4" );
+			    res.end( );
+		    } );
+		return *this;
+	}
+
+	json_rpc_server &
+	json_rpc_server::set_admission_options( admission_options opts ) & {
+		// Without a limit requests do not touch the shared counters at all
+		if( not details::is_admission_limited( opts ) ) {
+			m_admission.reset( );
+		} else if( m_admission ) {
+			m_admission->configure( opts );
+		} else {
+			m_admission = std::make_unique<details::concurrency_limiter>( opts );
+		}
+		return *this;
+	}
+
+	json_rpc_server &json_rpc_server::set_tracer( std::shared_ptr<tracer> t ) & {
+		m_tracer = std::move( t );
+		return *this;
+	}
+
+	json_rpc_server &
+	json_rpc_server::set_access_log( std::shared_ptr<access_log> log ) & {
+		m_access_log = std::move( log );
+		return *this;
+	}
+
+	json_rpc_server &
+	json_rpc_server::set_compression_options( compression_options opts ) & {
+		m_compression = opts;
+		return *this;
+	}
+
+	json_rpc_server &json_rpc_server::route_json_rpc(
+	  daw::string_view req_path,
+	  std::function<process_result( daw::string_view, std::string &,
+	                                deadline_type )>
+	    process ) & {
 		server.route_dynamic( static_cast<std::string>( req_path ) )
 		  .methods( crow::HTTPMethod::POST )(
-		    [&dispatcher]( crow::request const &req, crow::response &res ) {
+		    [process = std::move( process ),
+		     self = this]( crow::request const &req, crow::response &res ) {
 			    using namespace daw::json;
 
-			    auto args = details::json_rpc_server_request{ };
+			    auto const trace = details::trace_scope(
+			      self->m_tracer.get( ),
+			      request_trace_parent( self->m_tracer.get( ), req ) );
+			    auto span = details::span_scope( span_kind::request );
+			    auto const log =
+			      details::access_log_scope( self->m_access_log.get( ) );
+			    auto const coding =
+			      self->m_compression
+			        ? details::select_coding(
+			            req.get_header_value( "Accept-Encoding" ) )
+			        : details::content_coding::identity;
+			    auto ticket = details::admission_ticket( );
+			    if( auto *limiter = self->m_admission.get( ); limiter ) {
+				    ticket = details::admission_ticket( *limiter );
+				    if( not ticket ) {
+					    res.code = 503;
+					    res.body = server_busy_response( );
+					    res.add_header( "Content-Type", "application/json" );
+					    res.end( );
+					    return;
+				    }
+			    }
 			    try {
-				    try {
-					    args = from_json<details::json_rpc_server_request>( req.body );
-				    } catch( daw::json::json_exception const & ) {
-					    auto it = std::back_inserter( res.body );
-					    (void)to_json( json_rpc_response_error(
-					                     Error( -32700, "Error handling request" ) ),
-					                   it );
+				    auto result =
+				      process( req.body, res.body, request_deadline( req ) );
+				    if( not result.is_valid ) {
 					    res.code = 400;
 				    }
-				    dispatcher( args, res.body );
-				    if( args.id ) {
+				    if( result.deferred ) {
+					    // The response is left open and completed on the connection's I/O
+					    // thread once the asynchronous handlers are done.  The request
+					    // stays alive until the response has ended
+					    auto *r = &const_cast<crow::request &>( req );
+					    result.deferred.on_ready(
+					      [r, &res,
+					       state = std::make_shared<deferred_request>(
+					         deferred_request{ std::move( ticket ), span.detach( ) } )](
+					        std::string body ) {
+						      state->span.end( );
+						      r->post( [&res, body = std::move( body ), coding,
+						                self]( ) mutable {
+							      finish_response( res, std::move( body ), coding,
+							                       self->m_compression );
+						      } );
+					      } );
+					    return;
+				    }
+				    if( not res.body.empty( ) ) {
 					    res.add_header( "Content-Type", "application/json" );
-				    } else {
-					    res.body.clear( );
 				    }
 			    } catch( ... ) {
+				    res.body.clear( );
 				    auto it = std::back_inserter( res.body );
 				    (void)to_json( json_rpc_response_error(
 				                     Error( -32603, "Error handling request" ) ),
 				                   it );
 				    res.code = 500;
 			    }
+			    compress_body( res, coding, self->m_compression );
 			    res.end( );
 		    } );
 		return *this;
 	}
 
-	inline bool is_base_of( std::filesystem::path const &base,
-	                        std::filesystem::path const &path ) {
-		assert( is_directory( base ) );
-		return std::mismatch( base.begin( ), base.end( ), path.begin( ),
-		                      path.end( ) )
-		         .first == base.end( );
-	} // namespace
+	json_rpc_server &
+	json_rpc_server::websocket( daw::string_view req_path,
+	                            json_rpc_dispatch &dispatcher,
+	                            std::shared_ptr<thread_pool> pool ) & {
+		auto &ws =
+		  server.route_dynamic( static_cast<std::string>( req_path ) ).websocket( );
+		ws.onopen( []( crow::websocket::connection &conn ) {
+			conn.userdata(
+			  new ws_session_ptr( std::make_shared<ws_session>( conn ) ) );
+		} );
+		ws.onclose( []( crow::websocket::connection &conn, std::string const & ) {
+			auto *session = static_cast<ws_session_ptr *>( conn.userdata( ) );
+			conn.userdata( nullptr );
+			if( session ) {
+				( *session )->close( );
+				delete session;
+			}
+		} );
+		ws.onmessage( [&dispatcher, pool = std::move( pool ), self = this](
+		                crow::websocket::connection &conn, std::string const &msg,
+		                bool is_binary ) {
+			auto *session = static_cast<ws_session_ptr *>( conn.userdata( ) );
+			if( is_binary or not session ) {
+				return;
+			}
+			// Each frame begins a new trace
+			auto const trace =
+			  details::trace_scope( self->m_tracer.get( ), std::nullopt );
+			auto const log = details::access_log_scope( self->m_access_log.get( ) );
+			auto ticket = details::admission_ticket( );
+			if( auto *limiter = self->m_admission.get( ); limiter ) {
+				ticket = details::admission_ticket( *limiter );
+				if( not ticket ) {
+					( *session )->send( server_busy_response( ) );
+					return;
+				}
+			}
+			if( not pool ) {
+				process_ws_message(
+				  dispatcher, msg,
+				  [s = *session]( std::string r ) {
+					  s->send( std::move( r ) );
+				  },
+				  std::move( ticket ) );
+				return;
+			}
+			// A full pool turns the frame away, as the limiter would
+			auto const is_queued = pool->try_submit(
+			  [&dispatcher, s = *session, msg, self,
+			   trace = details::capture_trace( ),
+			   ticket = std::make_shared<details::admission_ticket>(
+			     std::move( ticket ) )] {
+				  auto const scope = details::trace_scope( trace );
+				  auto const log =
+				    details::access_log_scope( self->m_access_log.get( ) );
+				  process_ws_message(
+				    dispatcher, msg,
+				    [s]( std::string r ) {
+					    s->send( std::move( r ) );
+				    },
+				    std::move( *ticket ) );
+			  } );
+			if( not is_queued ) {
+				( *session )->send( server_busy_response( ) );
+			}
+		} );
+		return *this;
+	}
 
 	json_rpc_server &
 	json_rpc_server::route_path_to( daw::string_view req_path_prefix,
 	                                std::filesystem::path fs_base,
-	                                std::optional<std::string> default_file ) & {
+	                                std::optional<std::string> default_file,
+	                                static_file_options opts ) & {
 		assert( fs_base != std::filesystem::path( ) );
 		assert( exists( fs_base ) and is_directory( fs_base ) );
-		fs_base = canonical( fs_base );
+		auto files = std::make_shared<details::static_file_cache>(
+		  fs_base, std::move( default_file ), opts );
 		server.catchall_route( )(
 		  [=]( crow::request const &req, crow::response &res ) -> void {
 			  if( req.method != crow::HTTPMethod::GET ) {
 				  res = crow::response( 404 );
+				  res.end( );
 				  return;
 			  }
 			  try {
@@ -124,38 +602,54 @@ namespace daw::json_rpc {
 				  }
 				  auto rel_path_str = static_cast<std::string>( rel_path );
 				  crow::utility::sanitize_filename( rel_path_str );
-				  auto fs_path = fs_base / rel_path_str;
-				  if( not exists( fs_path ) ) {
-					  res = crow::response( 404 );
-					  return;
-				  }
-				  fs_path = canonical( fs_path );
-				  if( not is_base_of( fs_base, fs_path ) ) {
-					  res = crow::response( 404 );
-				  } else if( is_regular_file( fs_path ) ) {
-					  res.set_static_file_info_unsafe(
-					    static_cast<std::string>( fs_path ) );
-					  auto mmf = daw::filesystem::memory_mapped_file_t(
-					    static_cast<std::string>( fs_path ) );
-					  res.body = std::string( std::data( mmf ), daw::data_end( mmf ) );
-				  } else if( default_file and is_directory( fs_path ) ) {
-					  auto f = fs_path / ( *default_file );
-					  if( exists( f ) ) {
-						  res.set_static_file_info_unsafe( f );
-						  auto mmf = daw::filesystem::memory_mapped_file_t(
-						    static_cast<std::string>( f ) );
-						  res.body = std::string( std::data( mmf ), daw::data_end( mmf ) );
-					  } else {
-						  res = crow::response( 404 );
-					  }
+				  if( auto file = files->find( rel_path_str ); file ) {
+					  send_file( req, res, *file, opts );
 				  } else {
 					  res = crow::response( 404 );
 				  }
 			  } catch( std::exception const &ex ) {
-				  std::cerr << "Exception while processing file request: " << ex.what( )
-				            << '\n';
+				  CROW_LOG_ERROR << "Exception while processing file request: "
+				                 << ex.what( );
 				  res = crow::response( 500 );
 			  }
+			  res.end( );
+		  } );
+		return *this;
+	}
+
+	json_rpc_server &
+	json_rpc_server::route_path_to( daw::string_view req_path_prefix,
+	                                embedded_bundle const &bundle,
+	                                std::optional<std::string> default_file ) & {
+		server.catchall_route( )(
+		  [=, &bundle]( crow::request const &req, crow::response &res ) -> void {
+			  auto rel_path = daw::string_view( req.url );
+			  if( req.method != crow::HTTPMethod::GET or
+			      not rel_path.starts_with( req_path_prefix ) ) {
+				  res = crow::response( 404 );
+				  res.end( );
+				  return;
+			  }
+			  rel_path.remove_prefix( req_path_prefix.size( ) );
+			  if( rel_path.starts_with( '/' ) ) {
+				  rel_path.remove_prefix( 1 );
+			  }
+			  auto const *file =
+			    bundle.find( std::string_view( rel_path.data( ), rel_path.size( ) ) );
+			  if( not file and default_file ) {
+				  auto path = static_cast<std::string>( rel_path );
+				  if( not path.empty( ) and not path.ends_with( '/' ) ) {
+					  path += '/';
+				  }
+				  path += *default_file;
+				  file = bundle.find( path );
+			  }
+			  if( file ) {
+				  send_embedded( req, res, *file );
+			  } else {
+				  res = crow::response( 404 );
+			  }
+			  res.end( );
 		  } );
 		return *this;
 	}
@@ -0,0 +1,88 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#include "daw/json_rpc_socket_client.h"
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace daw::json_rpc {
+	namespace asio = boost::asio;
+
+	struct socket_client::impl_t {
+		asio::io_context ioc{ };
+		asio::generic::stream_protocol::socket socket{ ioc };
+		// Holds what has been read past the last response returned
+		std::string input{ };
+	};
+
+	socket_client::socket_client( std::unique_ptr<impl_t> impl )
+	  : m_impl( std::move( impl ) ) {}
+
+	socket_client::~socket_client( ) = default;
+	socket_client::socket_client( socket_client && ) noexcept = default;
+	socket_client &
+	socket_client::operator=( socket_client && ) noexcept = default;
+
+	socket_client socket_client::connect_tcp( std::string const &host,
+	                                          std::uint16_t port ) {
+		auto impl = std::make_unique<impl_t>( );
+		auto resolver = asio::ip::tcp::resolver( impl->ioc );
+		auto socket = asio::ip::tcp::socket( impl->ioc );
+		asio::connect( socket, resolver.resolve( host, std::to_string( port ) ) );
+		socket.set_option( asio::ip::tcp::no_delay( true ) );
+		impl->socket = std::move( socket );
+		return socket_client( std::move( impl ) );
+	}
+
+	socket_client
+	socket_client::connect_unix( std::filesystem::path const &path ) {
+#if defined( BOOST_ASIO_HAS_LOCAL_SOCKETS )
+		auto impl = std::make_unique<impl_t>( );
+		auto socket = asio::local::stream_protocol::socket( impl->ioc );
+		socket.connect( asio::local::stream_protocol::endpoint( path.string( ) ) );
+		impl->socket = std::move( socket );
+		return socket_client( std::move( impl ) );
+#else
+		(void)path;
+		throw std::system_error(
+		  std::make_error_code( std::errc::operation_not_supported ),
+		  "Unix domain sockets are not supported on this platform" );
+#endif
+	}
+
+	void socket_client::send( std::string_view json_doc ) {
+		auto const buffers = std::array<asio::const_buffer, 2>{
+		  asio::buffer( json_doc ), asio::buffer( "\n", 1 ) };
+		asio::write( m_impl->socket, buffers );
+	}
+
+	std::string socket_client::receive( ) {
+		auto const n = asio::read_until(
+		  m_impl->socket, asio::dynamic_buffer( m_impl->input ), '\n' );
+		auto result = m_impl->input.substr( 0, n - 1 );
+		m_impl->input.erase( 0, n );
+		return result;
+	}
+} // namespace daw::json_rpc
@@ -0,0 +1,433 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#include "daw/json_rpc_socket_server.h"
+#include "daw/json_rpc/json_rpc_buffer_pool.h"
+#include "daw/json_rpc/json_rpc_response_writer.h"
+
+#include <daw/daw_string_view.h>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace daw::json_rpc {
+	namespace asio = boost::asio;
+
+	inline namespace {
+		using executor_t = asio::strand<asio::io_context::executor_type>;
+		// TCP and Unix domain connections are served by the same code
+		using socket_t =
+		  asio::basic_stream_socket<asio::generic::stream_protocol, executor_t>;
+
+		class connection;
+
+		// Owns the connections of a server.  Asynchronous responses complete on
+		// other threads, possibly after the server is gone, so they only reach
+		// their connection through here while it is open
+		class connection_set {
+			std::mutex m_mutex{ };
+			bool m_is_open = true;
+			std::unordered_map<connection const *, std::shared_ptr<connection>>
+			  m_connections{ };
+
+		public:
+			void add( std::shared_ptr<connection> conn ) {
+				auto lck = std::unique_lock( m_mutex );
+				if( m_is_open ) {
+					auto const key = conn.get( );
+					m_connections.emplace( key, std::move( conn ) );
+				}
+			}
+
+			void remove( connection const *conn ) {
+				auto lck = std::unique_lock( m_mutex );
+				(void)m_connections.erase( conn );
+			}
+
+			// Runs f while no other thread can close the set
+			template<typename F>
+			void if_open( F &&f ) {
+				auto lck = std::unique_lock( m_mutex );
+				if( m_is_open ) {
+					f( );
+				}
+			}
+
+			// The connections are handed to the caller, to be destroyed while
+			// their io_context still exists
+			[[nodiscard]] std::unordered_map<connection const *,
+			                                 std::shared_ptr<connection>>
+			close( ) {
+				auto lck = std::unique_lock( m_mutex );
+				m_is_open = false;
+				return std::move( m_connections );
+			}
+		};
+
+		// Held by an asynchronous response until it is ready.  The limiter is
+		// shared as the response may complete after the server is gone
+		struct deferred_ticket {
+			std::shared_ptr<details::concurrency_limiter> limiter;
+			details::admission_ticket ticket;
+		};
+
+		// All members are used on the connection's strand.  A connection is owned
+		// by its server's connection_set until the peer has stopped sending and
+		// every response has been sent, or until it is closed
+		class connection : public std::enable_shared_from_this<connection> {
+			socket_t m_socket;
+			json_rpc_dispatch const &m_dispatcher;
+			socket_server_options const &m_options;
+			std::shared_ptr<connection_set> m_owner;
+			// Empty when no limit is set
+			std::shared_ptr<details::concurrency_limiter> m_limiter;
+			std::string m_input{ };
+			// Responses are queued while a write is in progress, and then sent
+			// together in one write
+			std::vector<std::string> m_queued{ };
+			std::vector<std::string> m_sending{ };
+			std::vector<asio::const_buffer> m_buffers{ };
+			std::size_t m_backlog = 0;
+			// Asynchronous responses not yet completed
+			std::size_t m_pending = 0;
+			bool m_is_read_paused = false;
+			bool m_is_reading = true;
+
+			void read( ) {
+				asio::async_read_until(
+				  m_socket,
+				  asio::dynamic_buffer( m_input, m_options.max_message_size ), '\n',
+				  [self = shared_from_this( )]( boost::system::error_code ec,
+				                                std::size_t n ) {
+					  // Once the peer has stopped sending, the connection lives until
+					  // the responses in flight have been sent.  A request longer than
+					  // max_message_size closes it at once
+					  if( ec ) {
+						  if( ec != asio::error::eof ) {
+							  self->close( );
+							  return;
+						  }
+						  self->m_is_reading = false;
+						  self->release_if_done( );
+						  return;
+					  }
+					  self->on_message( n );
+				  } );
+			}
+
+			void on_message( std::size_t n ) {
+				auto msg = std::string_view( m_input.data( ), n - 1 );
+				if( msg.ends_with( '\r' ) ) {
+					msg.remove_suffix( 1 );
+				}
+				if( not msg.empty( ) ) {
+					process( msg );
+				}
+				m_input.erase( 0, n );
+				if( m_backlog > m_options.max_write_backlog ) {
+					m_is_read_paused = true;
+					return;
+				}
+				read( );
+			}
+
+			void process( std::string_view msg ) {
+				// Each request begins a new trace
+				auto const trace =
+				  details::trace_scope( m_options.tracing.get( ), std::nullopt );
+				auto const log = details::access_log_scope( m_options.log.get( ) );
+				auto resp = details::acquire_buffer( );
+				auto ticket = details::admission_ticket( );
+				if( m_limiter ) {
+					ticket = details::admission_ticket( *m_limiter );
+					if( not ticket ) {
+						details::write_error_response( resp, Error( -32000, "Server busy" ),
+						                               details::raw_id_type{ } );
+						send( std::move( resp ) );
+						return;
+					}
+				}
+				try {
+					auto result = m_dispatcher.process(
+					  daw::string_view( msg.data( ), msg.size( ) ), resp );
+					if( result.deferred ) {
+						details::release_buffer( std::move( resp ) );
+						++m_pending;
+						result.deferred.on_ready(
+						  [conn = weak_from_this( ), owner = m_owner,
+						   state = std::make_shared<deferred_ticket>(
+						     deferred_ticket{ m_limiter, std::move( ticket ) } )](
+						    std::string r ) mutable {
+							  state.reset( );
+							  owner->if_open( [&] {
+								  auto self = conn.lock( );
+								  if( not self ) {
+									  return;
+								  }
+								  auto ex = self->m_socket.get_executor( );
+								  asio::post( ex, [self, r = std::move( r )]( ) mutable {
+									  self->on_deferred( std::move( r ) );
+								  } );
+							  } );
+						  } );
+						return;
+					}
+				} catch( ... ) {
+					resp.clear( );
+					details::write_error_response(
+					  resp, Error( -32603, "Error handling request" ),
+					  details::raw_id_type{ } );
+				}
+				if( resp.empty( ) ) {
+					details::release_buffer( std::move( resp ) );
+					return;
+				}
+				send( std::move( resp ) );
+			}
+
+			void on_deferred( std::string resp ) {
+				--m_pending;
+				if( resp.empty( ) ) {
+					release_if_done( );
+					return;
+				}
+				send( std::move( resp ) );
+			}
+
+			// Called with a reference to the connection held, as this may drop the
+			// set's
+			void release_if_done( ) {
+				if( not m_is_reading and m_pending == 0 and m_sending.empty( ) and
+				    m_queued.empty( ) ) {
+					m_owner->remove( this );
+				}
+			}
+
+			void send( std::string resp ) {
+				resp.push_back( '\n' );
+				m_backlog += resp.size( );
+				m_queued.push_back( std::move( resp ) );
+				if( m_sending.empty( ) ) {
+					write( );
+				}
+			}
+
+			void write( ) {
+				std::swap( m_sending, m_queued );
+				m_buffers.clear( );
+				for( auto const &resp : m_sending ) {
+					m_buffers.push_back( asio::buffer( resp ) );
+				}
+				asio::async_write(
+				  m_socket, m_buffers,
+				  [self = shared_from_this( )]( boost::system::error_code ec,
+				                                std::size_t n ) {
+					  if( ec ) {
+						  self->close( );
+						  return;
+					  }
+					  self->m_backlog -= n;
+					  for( auto &resp : self->m_sending ) {
+						  details::release_buffer( std::move( resp ) );
+					  }
+					  self->m_sending.clear( );
+					  if( not self->m_queued.empty( ) ) {
+						  self->write( );
+					  } else {
+						  self->release_if_done( );
+					  }
+					  if( self->m_is_read_paused and
+					      self->m_backlog <= self->m_options.max_write_backlog ) {
+						  self->m_is_read_paused = false;
+						  self->read( );
+					  }
+				  } );
+			}
+
+			// Responses still to complete are dropped
+			void close( ) {
+				auto ec = boost::system::error_code( );
+				m_socket.close( ec );
+				m_owner->remove( this );
+			}
+
+		public:
+			connection( socket_t socket, json_rpc_dispatch const &dispatcher,
+			            socket_server_options const &opts,
+			            std::shared_ptr<connection_set> owner,
+			            std::shared_ptr<details::concurrency_limiter> limiter )
+			  : m_socket( std::move( socket ) )
+			  , m_dispatcher( dispatcher )
+			  , m_options( opts )
+			  , m_owner( std::move( owner ) )
+			  , m_limiter( std::move( limiter ) ) {}
+
+			void start( ) {
+				// Responses are small and latency matters more than packet count.
+				// Fails harmlessly on Unix domain sockets
+				auto ec = boost::system::error_code( );
+				m_socket.set_option( asio::ip::tcp::no_delay( true ), ec );
+				m_owner->add( shared_from_this( ) );
+				read( );
+			}
+		};
+	} // namespace
+
+	struct socket_server::impl_t {
+		// How long to wait before accepting again after a failure such as running
+		// out of file descriptors, which would otherwise fail again at once
+		static constexpr auto accept_retry_delay = std::chrono::milliseconds( 100 );
+
+		json_rpc_dispatch const &dispatcher;
+		socket_server_options options;
+		asio::io_context ioc{ };
+		std::vector<std::unique_ptr<asio::ip::tcp::acceptor>> tcp_acceptors{ };
+#if defined( BOOST_ASIO_HAS_LOCAL_SOCKETS )
+		std::vector<std::unique_ptr<asio::local::stream_protocol::acceptor>>
+		  unix_acceptors{ };
+#endif
+		std::vector<std::filesystem::path> unix_paths{ };
+		std::uint16_t tcp_port = 0;
+		std::shared_ptr<connection_set> connections =
+		  std::make_shared<connection_set>( );
+		// Empty when no limit is set
+		std::shared_ptr<details::concurrency_limiter> limiter{ };
+
+		impl_t( json_rpc_dispatch const &d, socket_server_options opts )
+		  : dispatcher( d )
+		  , options( std::move( opts ) ) {
+			if( details::is_admission_limited( options.admission ) ) {
+				limiter =
+				  std::make_shared<details::concurrency_limiter>( options.admission );
+			}
+		}
+
+		~impl_t( ) {
+			// Closed first, so that no response completing on another thread
+			// reaches the io_context while it is destroyed
+			(void)connections->close( );
+			auto ec = std::error_code( );
+			for( auto const &path : unix_paths ) {
+				std::filesystem::remove( path, ec );
+			}
+		}
+
+		template<typename Protocol>
+		void accept( asio::basic_socket_acceptor<Protocol> &acceptor ) {
+			using accepted_t = typename Protocol::socket::template rebind_executor<
+			  executor_t>::other;
+			acceptor.async_accept(
+			  asio::make_strand( ioc ),
+			  [this, &acceptor]( boost::system::error_code ec, accepted_t socket ) {
+				  if( ec == asio::error::operation_aborted ) {
+					  return;
+				  }
+				  if( ec ) {
+					  auto timer =
+					    std::make_shared<asio::steady_timer>( ioc, accept_retry_delay );
+					  timer->async_wait(
+					    [this, &acceptor, timer]( boost::system::error_code wait_ec ) {
+						    if( not wait_ec ) {
+							    accept( acceptor );
+						    }
+					    } );
+					  return;
+				  }
+				  std::make_shared<connection>( socket_t( std::move( socket ) ),
+				                                dispatcher, options, connections,
+				                                limiter )
+				    ->start( );
+				  accept( acceptor );
+			  } );
+		}
+	};
+
+	socket_server::socket_server( json_rpc_dispatch const &dispatcher,
+	                              socket_server_options opts )
+	  : m_impl( std::make_unique<impl_t>( dispatcher, std::move( opts ) ) ) {}
+
+	socket_server::~socket_server( ) = default;
+
+	socket_server &socket_server::listen_tcp( std::string const &host,
+	                                          std::uint16_t port ) & {
+		auto resolver = asio::ip::tcp::resolver( m_impl->ioc );
+		auto const endpoint =
+		  resolver.resolve( host, std::to_string( port ) ).begin( )->endpoint( );
+		auto &acceptor = *m_impl->tcp_acceptors.emplace_back(
+		  std::make_unique<asio::ip::tcp::acceptor>( m_impl->ioc, endpoint ) );
+		m_impl->tcp_port = acceptor.local_endpoint( ).port( );
+		m_impl->accept( acceptor );
+		return *this;
+	}
+
+	socket_server &
+	socket_server::listen_unix( std::filesystem::path const &path ) & {
+#if defined( BOOST_ASIO_HAS_LOCAL_SOCKETS )
+		auto ec = std::error_code( );
+		if( std::filesystem::is_socket( path, ec ) ) {
+			std::filesystem::remove( path, ec );
+		}
+		auto const endpoint =
+		  asio::local::stream_protocol::endpoint( path.string( ) );
+		auto &acceptor = *m_impl->unix_acceptors.emplace_back(
+		  std::make_unique<asio::local::stream_protocol::acceptor>( m_impl->ioc,
+		                                                            endpoint ) );
+		m_impl->unix_paths.push_back( path );
+		m_impl->accept( acceptor );
+		return *this;
+#else
+		(void)path;
+		throw std::system_error(
+		  std::make_error_code( std::errc::operation_not_supported ),
+		  "Unix domain sockets are not supported on this platform" );
+#endif
+	}
+
+	std::uint16_t socket_server::tcp_port( ) const {
+		return m_impl->tcp_port;
+	}
+
+	socket_server &socket_server::run( ) & {
+		auto threads = std::vector<std::jthread>( );
+		for( std::size_t n = 1; n < m_impl->options.threads; ++n ) {
+			threads.emplace_back( [this] {
+				m_impl->ioc.run( );
+			} );
+		}
+		m_impl->ioc.run( );
+		return *this;
+	}
+
+	socket_server &socket_server::stop( ) & {
+		m_impl->ioc.stop( );
+		return *this;
+	}
+} // namespace daw::json_rpc
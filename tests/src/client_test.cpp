@@ -7,7 +7,9 @@
 //
 
 #include <daw/json_rpc_client.h>
+#include <daw/json_rpc_socket_client.h>
 
+#include <chrono>
 #include <iostream>
 
 int main( ) {
@@ -24,4 +26,19 @@ int main( ) {
 		throw r.error( );
 	}
 	std::cout << r.result( ) << '\n';
+
+	auto r2 = daw::json_rpc::json_rpc_client<int>(
+	  { .timeout = std::chrono::milliseconds( 500 ) }, "http://127.0.0.1:1234/",
+	  "add", "3", 3, 4 );
+	if( r2.has_error( ) ) {
+		throw r2.error( );
+	}
+	std::cout << r2.result( ) << '\n';
+
+	auto client = daw::json_rpc::socket_client::connect_tcp( "127.0.0.1", 1235 );
+	auto r3 = client.call<int>( "add", "4", 5, 6 );
+	if( r3.has_error( ) ) {
+		throw r3.error( );
+	}
+	std::cout << r3.result( ) << '\n';
 }
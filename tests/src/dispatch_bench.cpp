@@ -0,0 +1,106 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#include <daw/json_rpc/json_rpc_dispatch.h>
+#include <daw/json_rpc/json_rpc_request_json.h>
+#include <daw/json_rpc/json_rpc_static_dispatch.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+int add( int a, int b ) {
+	return a + b;
+}
+
+int sub( int a, int b ) {
+	return a - b;
+}
+
+int mul( int a, int b ) {
+	return a * b;
+}
+
+int status( ) {
+	return 42;
+}
+
+// Returns the time per call in ns
+template<typename Dispatcher>
+double bench( std::string_view title, Dispatcher const &dispatcher,
+              std::string_view req_json, std::string_view expected ) {
+	constexpr std::size_t iterations = 1'000'000;
+	auto const req =
+	  daw::json::from_json<daw::json_rpc::details::json_rpc_server_request>(
+	    req_json );
+	auto buff = std::string( );
+	auto const start = std::chrono::steady_clock::now( );
+	for( std::size_t n = 0; n < iterations; ++n ) {
+		buff.clear( );
+		(void)dispatcher( req, buff );
+	}
+	auto const elapsed = std::chrono::steady_clock::now( ) - start;
+	if( buff != expected ) {
+		std::cerr << title << ": unexpected response " << buff << '\n';
+		std::exit( EXIT_FAILURE );
+	}
+	auto const ns = std::chrono::duration<double, std::nano>( elapsed ).count( ) /
+	                static_cast<double>( iterations );
+	std::cout << title << ": " << ns << "ns/call\n";
+	return ns;
+}
+
+daw::json_rpc::json_rpc_dispatch make_dynamic_dispatch( bool is_measured ) {
+	auto result = daw::json_rpc::json_rpc_dispatch( );
+	result.set_metrics_options( { .enabled = is_measured } )
+	  .add_method( "add", &add )
+	  .add_method( "sub", &sub )
+	  .add_method( "mul", &mul )
+	  .add_method( "status", &status );
+	return result;
+}
+
+// static_dispatch keeps no metrics, so it is compared with a json_rpc_dispatch
+// that does not either.  The default, measured, configuration is shown too
+template<typename Static>
+void compare( std::string_view name, Static const &static_dispatch,
+              std::string_view req, std::string_view resp ) {
+	auto const measured = make_dynamic_dispatch( true );
+	auto const unmeasured = make_dynamic_dispatch( false );
+	auto const with_metrics =
+	  bench( "json_rpc_dispatch " + std::string( name ) + " with metrics",
+	         measured, req, resp );
+	auto const dynamic = bench( "json_rpc_dispatch " + std::string( name ),
+	                            unmeasured, req, resp );
+	auto const fixed = bench( "static_dispatch " + std::string( name ),
+	                          static_dispatch, req, resp );
+	std::cout << name << ": json_rpc_dispatch/static_dispatch " << dynamic / fixed
+	          << "x, with metrics " << with_metrics / fixed << "x\n";
+}
+
+int main( ) {
+	auto const static_dispatch =
+	  daw::json_rpc::static_dispatch<daw::json_rpc::method<"add", &add>,
+	                                 daw::json_rpc::method<"sub", &sub>,
+	                                 daw::json_rpc::method<"mul", &mul>,
+	                                 daw::json_rpc::method<"status", &status>>{ };
+
+	constexpr std::string_view add_req =
+	  R"({"jsonrpc":"2.0","method":"add","params":[1,2],"id":1})";
+	constexpr std::string_view add_resp = R"({"jsonrpc":"2.0","result":3,"id":1})";
+	constexpr std::string_view status_req =
+	  R"({"jsonrpc":"2.0","method":"status","id":1})";
+	constexpr std::string_view status_resp =
+	  R"({"jsonrpc":"2.0","result":42,"id":1})";
+
+	compare( "add", static_dispatch, add_req, add_resp );
+	compare( "status", static_dispatch, status_req, status_resp );
+}
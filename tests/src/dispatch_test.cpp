@@ -0,0 +1,369 @@
+// Copyright (c) Darrell Wright
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/beached/jsonrpc
+//
+
+#include <daw/json_rpc/json_rpc_dispatch.h>
+#include <daw/json_rpc/json_rpc_stream.h>
+#include <daw/json_rpc_socket_client.h>
+#include <daw/json_rpc_socket_server.h>
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+	void check( bool condition, std::string_view what ) {
+		if( not condition ) {
+			std::cerr << "FAILED: " << what << '\n';
+			std::exit( EXIT_FAILURE );
+		}
+	}
+
+	void check_equal( std::string_view actual, std::string_view expected,
+	                  std::string_view what ) {
+		if( actual != expected ) {
+			std::cerr << "FAILED: " << what << "\n  expected: " << expected
+			          << "\n  actual:   " << actual << '\n';
+			std::exit( EXIT_FAILURE );
+		}
+	}
+
+	// The response to doc, ready once it has been sent
+	std::future<std::string>
+	send( daw::json_rpc::json_rpc_dispatch const &dispatcher,
+	      std::string_view doc ) {
+		auto promise = std::make_shared<std::promise<std::string>>( );
+		auto response = promise->get_future( );
+		auto buff = std::string( );
+		auto result = dispatcher.process(
+		  daw::string_view( doc.data( ), doc.size( ) ), buff );
+		if( result.deferred ) {
+			result.deferred.on_ready( [promise]( std::string r ) {
+				promise->set_value( std::move( r ) );
+			} );
+		} else {
+			promise->set_value( std::move( buff ) );
+		}
+		return response;
+	}
+
+	std::string call( daw::json_rpc::json_rpc_dispatch const &dispatcher,
+	                  std::string_view doc ) {
+		return send( dispatcher, doc ).get( );
+	}
+
+	void check_cache( ) {
+		auto dispatcher = daw::json_rpc::json_rpc_dispatch( );
+		int calls = 0;
+		dispatcher.add_method(
+		  "next", [&]( int n ) { return n + calls++; },
+		  { .cache = { .ttl = std::chrono::minutes( 1 ) } } );
+
+		check_equal(
+		  call( dispatcher,
+		        R"({"jsonrpc":"2.0","method":"next","params":[1],"id":1})" ),
+		  R"({"jsonrpc":"2.0","result":1,"id":1})", "cache miss" );
+		// A hit is written with the id of the request it answers
+		check_equal(
+		  call( dispatcher,
+		        R"({"jsonrpc":"2.0","method":"next","params":[ 1 ],"id":"a"})" ),
+		  R"({"jsonrpc":"2.0","result":1,"id":"a"})", "cache hit with another id" );
+		check_equal(
+		  call( dispatcher,
+		        R"({"jsonrpc":"2.0","method":"next","params":[2],"id":3})" ),
+		  R"({"jsonrpc":"2.0","result":3,"id":3})", "cache miss on other params" );
+		auto const stats = dispatcher.get_cache_stats( "next" );
+		check( stats.hits == 1 and stats.misses == 2, "cache stats" );
+
+		// A result sent in parts cannot be stored
+		bool is_rejected = false;
+		try {
+			dispatcher.add_method(
+			  "iota",
+			  []( int count ) -> daw::json_rpc::generator<int> {
+				  for( int n = 0; n < count; ++n ) {
+					  co_yield n;
+				  }
+			  },
+			  { .cache = { .ttl = std::chrono::minutes( 1 ) } } );
+		} catch( std::invalid_argument const & ) {
+			is_rejected = true;
+		}
+		check( is_rejected, "caching a streamed method is rejected" );
+	}
+
+	void check_single_flight( ) {
+		auto dispatcher = daw::json_rpc::json_rpc_dispatch( );
+		auto gate = std::promise<void>( );
+		auto const opened = gate.get_future( ).share( );
+		auto calls = std::atomic<int>( 0 );
+		dispatcher.add_pool( "flight", 1 ).add_method(
+		  "double",
+		  [&, opened]( int n ) {
+			  opened.wait( );
+			  ++calls;
+			  return n * 2;
+		  },
+		  { .pool = "flight", .single_flight = true } );
+
+		// Waiters get the leader's result with their own id
+		auto leader =
+		  send( dispatcher,
+		        R"({"jsonrpc":"2.0","method":"double","params":[4],"id":1})" );
+		auto waiter = send(
+		  dispatcher,
+		  R"({"jsonrpc":"2.0","method":"double","params":[ 4 ],"id":"second"})" );
+		gate.set_value( );
+		check_equal( leader.get( ), R"({"jsonrpc":"2.0","result":8,"id":1})",
+		             "leader result" );
+		check_equal( waiter.get( ),
+		             R"({"jsonrpc":"2.0","result":8,"id":"second"})",
+		             "waiter id patched" );
+		check( calls == 1, "handler ran once for both" );
+	}
+
+	// Errors that concern only the leader are not shared with its waiters
+	void check_single_flight_leader_errors( ) {
+		auto dispatcher = daw::json_rpc::json_rpc_dispatch( );
+		auto started = std::promise<void>( );
+		auto gate = std::promise<void>( );
+		auto const opened = gate.get_future( ).share( );
+		auto calls = std::atomic<int>( 0 );
+		dispatcher.add_pool( "flight", 1 )
+		  .add_method( "block",
+		               [&, opened]( ) {
+			               started.set_value( );
+			               opened.wait( );
+			               return true;
+		               },
+		               { .pool = "flight" } )
+		  .add_method( "double",
+		               [&]( int n ) {
+			               ++calls;
+			               return n * 2;
+		               },
+		               { .pool = "flight",
+		                 .single_flight = true,
+		                 .admission = { .max_in_flight = 2 } } );
+
+		auto blocked =
+		  send( dispatcher, R"({"jsonrpc":"2.0","method":"block","id":0})" );
+		started.get_future( ).wait( );
+		// Times out in the pool's queue, behind block
+		auto leader = send(
+		  dispatcher,
+		  R"({"jsonrpc":"2.0","method":"double","params":[3],"id":1,"timeout_ms":10})" );
+		auto waiter = send(
+		  dispatcher,
+		  R"({"jsonrpc":"2.0","method":"double","params":[3],"id":"w"})" );
+		// Admission comes before joining, so this is turned away by itself
+		check_equal(
+		  call( dispatcher,
+		        R"({"jsonrpc":"2.0","method":"double","params":[3],"id":2})" ),
+		  R"({"jsonrpc":"2.0","error":{"code":-32000,"message":"Server busy"},"id":2})",
+		  "admission before joining" );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+		gate.set_value( );
+		check_equal( blocked.get( ), R"({"jsonrpc":"2.0","result":true,"id":0})",
+		             "blocking call" );
+		check( leader.get( ).find( R"("code":-32002)" ) != std::string::npos,
+		       "leader past its deadline" );
+		// The deadline was the leader's own, so the waiter runs the call itself
+		check_equal( waiter.get( ), R"({"jsonrpc":"2.0","result":6,"id":"w"})",
+		             "waiter retries as leader" );
+		check( calls == 1, "handler ran for the waiter only" );
+	}
+
+	void check_admission( ) {
+		auto dispatcher = daw::json_rpc::json_rpc_dispatch( );
+		auto gate = std::promise<void>( );
+		auto const opened = gate.get_future( ).share( );
+		dispatcher.add_pool( "limited", 2 ).add_method(
+		  "wait", [opened]( int n ) { opened.wait( ); return n; },
+		  { .pool = "limited", .admission = { .max_in_flight = 1 } } );
+
+		auto first = send(
+		  dispatcher, R"({"jsonrpc":"2.0","method":"wait","params":[1],"id":1})" );
+		check_equal(
+		  call( dispatcher,
+		        R"({"jsonrpc":"2.0","method":"wait","params":[2],"id":2})" ),
+		  R"({"jsonrpc":"2.0","error":{"code":-32000,"message":"Server busy"},"id":2})",
+		  "over the limit" );
+		gate.set_value( );
+		check_equal( first.get( ), R"({"jsonrpc":"2.0","result":1,"id":1})",
+		             "under the limit" );
+		// The slot is given back once the response is ready
+		check_equal(
+		  call( dispatcher,
+		        R"({"jsonrpc":"2.0","method":"wait","params":[3],"id":3})" ),
+		  R"({"jsonrpc":"2.0","result":3,"id":3})", "slot released" );
+
+		// A target latency alone still limits the method
+		auto adaptive = daw::json_rpc::json_rpc_dispatch( );
+		adaptive.add_method(
+		  "id", []( int n ) { return n; },
+		  { .admission = { .target_latency = std::chrono::milliseconds( 5 ) } } );
+		check_equal(
+		  call( adaptive, R"({"jsonrpc":"2.0","method":"id","params":[4],"id":4})" ),
+		  R"({"jsonrpc":"2.0","result":4,"id":4})", "adaptive limit" );
+	}
+
+	// Appends the values of the result array of a streamed response
+	void append_values( std::string_view part, std::vector<int> &values ) {
+		constexpr auto prefix =
+		  std::string_view( R"({"jsonrpc":"2.0","result":[)" );
+		check( part.starts_with( prefix ), "part begins a response" );
+		part.remove_prefix( prefix.size( ) );
+		part = part.substr( 0, part.find( ']' ) );
+		while( not part.empty( ) ) {
+			auto value = 0;
+			auto const r =
+			  std::from_chars( part.data( ), part.data( ) + part.size( ), value );
+			check( r.ec == std::errc{ }, "part holds numbers" );
+			values.push_back( value );
+			part.remove_prefix( static_cast<std::size_t>( r.ptr - part.data( ) ) );
+			if( part.starts_with( ',' ) ) {
+				part.remove_prefix( 1 );
+			}
+		}
+	}
+
+	void check_streaming( ) {
+		auto dispatcher = daw::json_rpc::json_rpc_dispatch( );
+		dispatcher.add_method(
+		  "iota", []( int count ) -> daw::json_rpc::generator<int> {
+			  for( int n = 0; n < count; ++n ) {
+				  co_yield n;
+			  }
+		  } );
+		// Large enough to be sent in several parts
+		constexpr std::size_t count = 50'000;
+		constexpr std::string_view req =
+		  R"({"jsonrpc":"2.0","method":"iota","params":[50000],"id":7})";
+
+		// Without a sink the whole result is a single response
+		auto values = std::vector<int>( );
+		auto const whole = call( dispatcher, req );
+		check( whole.ends_with( R"(],"id":7})" ), "whole response" );
+		append_values( whole, values );
+		check( values.size( ) == count, "whole response values" );
+
+		auto parts = std::vector<std::string>( );
+		auto const sink = daw::json_rpc::details::stream_sink_scope(
+		  std::make_shared<daw::json_rpc::details::stream_sink const>(
+		    [&]( std::string part ) {
+			    parts.push_back( std::move( part ) );
+		    } ) );
+		auto const last = call( dispatcher, req );
+		check( parts.size( ) > 1, "sent in parts" );
+		values.clear( );
+		for( auto const &part : parts ) {
+			check( part.ends_with( R"(],"id":7,"partial":true})" ),
+			       "partial part" );
+			append_values( part, values );
+		}
+		// The last part is an ordinary response
+		check( last.ends_with( R"(],"id":7})" ), "last part" );
+		append_values( last, values );
+		check( values.size( ) == count, "all values sent" );
+		for( std::size_t n = 0; n < count; ++n ) {
+			check( values[n] == static_cast<int>( n ), "values in order" );
+		}
+
+		// A notification has no response, so no parts of one are sent either
+		parts.clear( );
+		check_equal(
+		  call( dispatcher,
+		        R"({"jsonrpc":"2.0","method":"iota","params":[50000]})" ),
+		  "", "streamed notification" );
+		check( parts.empty( ), "no parts for a notification" );
+	}
+
+	void check_deadlines( ) {
+		auto dispatcher = daw::json_rpc::json_rpc_dispatch( );
+		auto calls = std::atomic<int>( 0 );
+		dispatcher.add_method( "inc", [&]( ) { return ++calls; } );
+
+		// Expired requests are dropped before reaching the handler
+		check_equal(
+		  call( dispatcher,
+		        R"({"jsonrpc":"2.0","method":"inc","id":1,"timeout_ms":0})" ),
+		  R"({"jsonrpc":"2.0","error":{"code":-32002,"message":"Deadline exceeded"},"id":1})",
+		  "expired request" );
+		check_equal(
+		  call( dispatcher, R"({"jsonrpc":"2.0","method":"inc","timeout_ms":0})" ),
+		  "", "expired notification" );
+		check( calls == 0, "expired requests are not run" );
+
+		// Timeouts are not trusted: negative ones are ignored and long ones are
+		// shortened rather than overflowing in to the past
+		check_equal(
+		  call( dispatcher,
+		        R"({"jsonrpc":"2.0","method":"inc","id":2,"timeout_ms":-1})" ),
+		  R"({"jsonrpc":"2.0","result":1,"id":2})", "negative timeout" );
+		check_equal(
+		  call(
+		    dispatcher,
+		    R"({"jsonrpc":"2.0","method":"inc","id":3,"timeout_ms":9223372036854775807})" ),
+		  R"({"jsonrpc":"2.0","result":2,"id":3})", "overlong timeout" );
+	}
+
+	void check_socket_pipelining( ) {
+		auto dispatcher = daw::json_rpc::json_rpc_dispatch( );
+		dispatcher.add_method( "echo", []( int n ) { return n; } );
+		auto server = daw::json_rpc::socket_server( dispatcher, { .threads = 2 } );
+		server.listen_tcp( "127.0.0.1", 0 );
+		auto runner = std::thread( [&] {
+			server.run( );
+		} );
+
+		// Requests sent before any response is read are answered in order
+		constexpr int count = 100;
+		{
+			auto client =
+			  daw::json_rpc::socket_client::connect_tcp( "127.0.0.1",
+			                                             server.tcp_port( ) );
+			for( int n = 0; n < count; ++n ) {
+				auto const id = std::to_string( n );
+				client.send( R"({"jsonrpc":"2.0","method":"echo","params":[)" + id +
+				             R"(],"id":)" + id + "}" );
+			}
+			for( int n = 0; n < count; ++n ) {
+				auto const id = std::to_string( n );
+				check_equal( client.receive( ),
+				             R"({"jsonrpc":"2.0","result":)" + id + R"(,"id":)" +
+				               id + "}",
+				             "pipelined response order" );
+			}
+		}
+		server.stop( );
+		runner.join( );
+	}
+} // namespace
+
+int main( ) {
+	check_cache( );
+	check_single_flight( );
+	check_single_flight_leader_errors( );
+	check_admission( );
+	check_streaming( );
+	check_deadlines( );
+	check_socket_pipelining( );
+	std::cout << "dispatch checks passed\n";
+}
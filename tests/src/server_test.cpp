@@ -6,12 +6,18 @@
 // Official repository: https://github.com/beached/jsonrpc
 //
 
+#include "test_assets.h"
 #include "validate_email.h"
 #include <daw/json_rpc_server.h>
+#include <daw/json_rpc_socket_server.h>
 
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <string_view>
+#include <thread>
 #include <tuple>
+#include <version>
 
 struct User {
 	std::string id;
@@ -77,23 +83,90 @@ namespace daw::json {
 std::size_t count = 0;
 
 int main( ) {
+	auto pool = std::make_shared<daw::json_rpc::thread_pool>( 4 );
 	auto dispatcher = daw::json_rpc::json_rpc_dispatch( );
-	dispatcher
+	dispatcher.add_pool( "heavy", 2, 1024 )
 	  .add_method( "CreateUser",
-	               [&]( User u ) {
+	               [&]( User u )
+	                 -> daw::json_rpc::expected<
+	                   User, daw::json_rpc::Error<std::string>> {
 		               if( auto m = validate( u ); not m.empty( ) ) {
-			               throw std::runtime_error( static_cast<std::string>( m ) );
+			               return daw::json_rpc::unexpected( daw::json_rpc::Error(
+			                 -32001, "Invalid user", static_cast<std::string>( m ) ) );
 		               }
 		               u.id = "1000000";
 		               ++count;
 		               return DAW_MOVE( u );
-	               } )
+	               },
+	               { .pool = "heavy", .admission = { .max_in_flight = 256 } } )
 	  .add_method<int( int, int )>( "add", []( auto a, int b ) { return a + b; } )
-	  .add_method( "status", [&]( ) { return count; } )
-	  .add_method( "inc_count", [&]( ) { return count++; } );
+	  .add_method( "health", []( ) { return true; },
+	               { .pool = "heavy", .lane = daw::json_rpc::priority::high } )
+	  .add_method( "status", [&]( ) { return count; },
+	               { .cache = { .ttl = std::chrono::milliseconds( 100 ) },
+	                 .single_flight = true } )
+	  .add_method( "inc_count", [&]( ) { return count++; } )
+	  .add_method( "name_length",
+	               []( daw::string_view name ) { return name.size( ); } )
+	  .add_method( "sum",
+	               []( daw::json::json_array_range<int> values ) {
+		               int result = 0;
+		               for( int v : values ) {
+			               result += v;
+		               }
+		               return result;
+	               } )
+	  .add_method( "echo",
+	               []( daw::json_rpc::raw_params params ) {
+		               if( params.json( ).empty( ) ) {
+			               return daw::json_rpc::raw_json{ "null" };
+		               }
+		               return daw::json_rpc::raw_json{
+		                 static_cast<std::string>( params.json( ) ) };
+	               } )
+	  .add_method( "iota",
+	               []( int count ) -> daw::json_rpc::generator<int> {
+		               for( int n = 0; n < count; ++n ) {
+			               co_yield n;
+		               }
+	               } )
+	  .add_method( "async_add",
+	               []( int a, int b ) -> daw::json_rpc::task<int> {
+		               co_return a + b;
+	               } )
+	  .set_batch_options( { .pool = pool, .max_fan_out = 4 } );
+#if defined( __cpp_lib_expected )
+	dispatcher.add_method(
+	  "checked_div",
+	  []( int a, int b ) -> std::expected<int, daw::json_rpc::Error<int>> {
+		  if( b == 0 ) {
+			  return std::unexpected(
+			    daw::json_rpc::Error( -32002, "Division by zero", a ) );
+		  }
+		  return a / b;
+	  } );
+#endif
+
+	// The same methods without HTTP, for clients on the same host
+	auto socket_server =
+	  daw::json_rpc::socket_server( dispatcher, { .threads = 2 } );
+	socket_server.listen_tcp( "127.0.0.1", 1235 );
+	auto socket_thread = std::jthread( [&] {
+		socket_server.run( );
+	} );
 
 	auto server = daw::json_rpc::json_rpc_server( );
-	server.route_path_to( "/", dispatcher )
+	server
+	  .set_admission_options(
+	    { .max_in_flight = 4096,
+	      .target_latency = std::chrono::milliseconds( 50 ),
+	      .min_in_flight = 64 } )
+	  .set_access_log( std::make_shared<daw::json_rpc::access_log>(
+	    daw::json_rpc::access_log_options{ .path = "json_rpc_access.log" } ) )
+	  .set_compression_options( { .min_size = 4096 } )
+	  .route_path_to( "/", dispatcher )
+	  .route_metrics( "/metrics", dispatcher )
+	  .route_path_to( "/assets", test_assets, "index.html" )
 	  .route_path_to( "/add", "GET",
 	                  [&]( crow::request const &, crow::response &res ) {
 		                  res.body = std::to_string( ++count );
@@ -103,6 +176,7 @@ int main( ) {
 	                  [&]( crow::request const &, crow::response &res ) {
 		                  res.end( );
 		                  server.stop( );
+		                  socket_server.stop( );
 	                  } )
 	  .websocket(
 	    "/file_upload",
@@ -112,5 +186,6 @@ int main( ) {
 	        []( crow::websocket::connection &, std::string const &message ) {
 		        std::cerr << message << '\n';
 	        } } )
+	  .websocket( "/ws", dispatcher, pool )
 	  .listen( 1234 );
 }